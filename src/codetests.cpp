@@ -1,5 +1,6 @@
 #include <cassert>
 #include <cctype>
+#include <chrono>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
@@ -544,6 +545,8 @@ executeCodeTests(const std::string &assembler, const std::string &directory)
       return false;
    }
 
+   auto runTime = std::chrono::high_resolution_clock::duration::zero();
+
    // Find all tests in directory
    for (auto itr = fs::directory_iterator { directory }; itr != fs::directory_iterator(); ++itr) {
       TestFile tests;
@@ -591,6 +594,8 @@ executeCodeTests(const std::string &assembler, const std::string &directory)
             gJitManager.prepare(baseAddress + test.second.offset);
          }
 
+         auto startTime = std::chrono::high_resolution_clock::now();
+
          // Run test with all state set to 0x00
          gLog->debug(" Running with 0x00");
          memset(&state, 0x00, sizeof(ThreadState));
@@ -603,6 +608,8 @@ executeCodeTests(const std::string &assembler, const std::string &directory)
          state.tracer = nullptr;
          result &= executeCodeTest(state, baseAddress, test.second);
 
+         runTime += std::chrono::high_resolution_clock::now() - startTime;
+
          // BUT WAS IT SUCCESS??
          if (!result) {
             gLog->debug(" - FAILED");
@@ -615,5 +622,19 @@ executeCodeTests(const std::string &assembler, const std::string &directory)
       fs::remove("tmp.elf");
    }
 
+   // Report generated code size, to compare JIT changes against
+   gLog->info("Tests ran for {} us", std::chrono::duration_cast<std::chrono::microseconds>(runTime).count());
+
+   if (gInterpreter.getJitMode() == InterpJitMode::Enabled) {
+      auto &stats = gJitManager.getStats();
+      gLog->info("JIT generated {} blocks, {} guest instructions, {} bytes of host code ({:.1f} bytes per instruction)",
+                 stats.blocks, stats.guestInstructions, stats.hostBytes,
+                 stats.guestInstructions ? static_cast<double>(stats.hostBytes) / stats.guestInstructions : 0.0);
+   }
+
+   if (gInterpreter.getJitMode() == InterpJitMode::Verify) {
+      gLog->info("JIT verified {} blocks, {} failed", gInterpreter.getVerifiedBlocks(), gInterpreter.getVerifyFailures());
+   }
+
    return true;
 }
@@ -12,6 +12,7 @@
 #include "debugmsg.h"
 #include "debugnet.h"
 #include "debugcontrol.h"
+#include "interpreter.h"
 
 static const bool FORCE_DEBUGGER_ON = false;
 
@@ -119,6 +120,7 @@ Debugger::initialise()
 
    if (mEnabled) {
       mDebuggerThread = std::thread(&Debugger::debugThread, this);
+      gInterpreter.reselectLoop();
    }
 }
 
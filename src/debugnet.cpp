@@ -11,6 +11,7 @@
 #include "debugger.h"
 #include "disassembler.h"
 #include "instructiondata.h"
+#include "jit.h"
 #include "log.h"
 #include "memory.h"
 #include "modules/coreinit/coreinit_thread.h"
@@ -95,6 +96,18 @@ struct DebugThreadInfo {
    }
 };
 
+struct DebugProfileEntry {
+   uint32_t start;
+   uint32_t hostSize;
+   uint64_t count;
+   uint64_t cycles;
+
+   template <class Archive>
+   void serialize(Archive &ar) {
+      ar(start, hostSize, count, cycles);
+   }
+};
+
 struct DebugPauseInfo {
    std::vector<DebugModuleInfo> modules;
    uint32_t userModuleIdx;
@@ -229,6 +242,8 @@ enum class DebugPacketType : uint16_t {
    GetTrace = 14,
    GetTraceRes = 15,
    StepCoreOver = 16,
+   GetProfile = 17,
+   GetProfileRes = 18,
 };
 
 #pragma pack(push, 1)
@@ -420,6 +435,28 @@ public:
 
 };
 
+class DebugPacketGetProfile : public DebugPacketBase<DebugPacketType::GetProfile> {
+public:
+   uint32_t maxEntries;
+
+   template <class Archive>
+   void serialize(Archive &ar) {
+      ar(maxEntries);
+   }
+
+};
+
+class DebugPacketGetProfileRes : public DebugPacketBase<DebugPacketType::GetProfileRes> {
+public:
+   std::vector<DebugProfileEntry> entries;
+
+   template <class Archive>
+   void serialize(Archive &ar) {
+      ar(entries);
+   }
+
+};
+
 template <typename T>
 int serializePacket2(std::vector<uint8_t> &data, DebugPacket *packet) {
    std::ostringstream str;
@@ -491,6 +528,10 @@ int serializePacket(std::vector<uint8_t> &data, DebugPacket *packet)
       return serializePacket2<DebugPacketGetTraceRes>(data, packet);
    } else if (header.command == DebugPacketType::StepCoreOver) {
       return serializePacket2<DebugPacketStepCoreOver>(data, packet);
+   } else if (header.command == DebugPacketType::GetProfile) {
+      return serializePacket2<DebugPacketGetProfile>(data, packet);
+   } else if (header.command == DebugPacketType::GetProfileRes) {
+      return serializePacket2<DebugPacketGetProfileRes>(data, packet);
    } else {
       return -1;
    }
@@ -532,6 +573,10 @@ int deserializePacket(const std::vector<uint8_t> &data, DebugPacket *&packet) {
       return deserializePacket2<DebugPacketGetTraceRes>(data, packet);
    } else if (header.command == DebugPacketType::StepCoreOver) {
       return deserializePacket2<DebugPacketStepCoreOver>(data, packet);
+   } else if (header.command == DebugPacketType::GetProfile) {
+      return deserializePacket2<DebugPacketGetProfile>(data, packet);
+   } else if (header.command == DebugPacketType::GetProfileRes) {
+      return deserializePacket2<DebugPacketGetProfileRes>(data, packet);
    } else {
       return -1;
    }
@@ -752,6 +797,23 @@ DebugNet::handlePacket(DebugPacket *pak)
 
       break;
    }
+   case DebugPacketType::GetProfile: {
+      auto *pPak = static_cast<DebugPacketGetProfile*>(pak);
+      auto profile = gJitManager.getProfile();
+      auto pakO = new DebugPacketGetProfileRes();
+
+      for (auto i = 0u; i < profile.size() && i < pPak->maxEntries; ++i) {
+         DebugProfileEntry entry;
+         entry.start = profile[i].start;
+         entry.hostSize = profile[i].hostSize;
+         entry.count = profile[i].count;
+         entry.cycles = profile[i].cycles;
+         pakO->entries.push_back(entry);
+      }
+
+      writePacket(pakO);
+      break;
+   }
    }
 }
 
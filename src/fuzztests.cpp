@@ -113,6 +113,32 @@ executeInstrTest(uint32_t test_seed, InstructionID instrId)
    return true;
 }
 
+// Every encoding has to decode the same through the flat tables as
+//   through the opcode tree they are built from.
+bool
+checkDecodeTables()
+{
+   uint64_t mismatches = 0;
+
+   for (uint64_t value = 0; value <= 0xFFFFFFFFull; ++value) {
+      auto instr = Instruction { static_cast<uint32_t>(value) };
+      auto data = gInstructionTable.decode(instr);
+      auto expected = gInstructionTable.decodeTree(instr);
+
+      if (data != expected && mismatches++ < 16) {
+         gLog->error("Decode mismatch for {:08x}, got {} expected {}",
+                     instr.value, data ? data->name : "none", expected ? expected->name : "none");
+      }
+   }
+
+   if (mismatches) {
+      gLog->error("{} encodings decoded differently", mismatches);
+      return false;
+   }
+
+   return true;
+}
+
 bool
 executeFuzzTests(uint32_t suite_seed)
 {
@@ -2,4 +2,7 @@
 #include "types.h"
 
 bool
-executeFuzzTests(uint32_t suite_seed = 0x12345678);
\ No newline at end of file
+executeFuzzTests(uint32_t suite_seed = 0x12345678);
+
+bool
+checkDecodeTables();
@@ -0,0 +1,117 @@
+#include <string>
+#include <vector>
+#include "bitutils.h"
+#include "idleloop.h"
+#include "instructiondata.h"
+#include "memory.h"
+
+// Instructions which only read memory or write registers and CR
+static bool
+isIdleInstruction(InstructionID id)
+{
+   switch (id) {
+   case InstructionID::lbz:
+   case InstructionID::lbzx:
+   case InstructionID::lha:
+   case InstructionID::lhax:
+   case InstructionID::lhz:
+   case InstructionID::lhzx:
+   case InstructionID::lwz:
+   case InstructionID::lwzx:
+   case InstructionID::cmp:
+   case InstructionID::cmpi:
+   case InstructionID::cmpl:
+   case InstructionID::cmpli:
+   case InstructionID::addi:
+   case InstructionID::addis:
+   case InstructionID::and_:
+   case InstructionID::andi:
+   case InstructionID::andis:
+   case InstructionID::or_:
+   case InstructionID::ori:
+   case InstructionID::oris:
+   case InstructionID::rlwinm:
+   case InstructionID::extsb:
+   case InstructionID::extsh:
+   case InstructionID::sync:
+   case InstructionID::isync:
+      return true;
+   default:
+      return false;
+   }
+}
+
+// GPRs read or written by instr, as a bitmask
+static uint32_t
+gprMask(const std::vector<Field> &fields, Instruction instr)
+{
+   uint32_t mask = 0;
+
+   for (auto field : fields) {
+      switch (field) {
+      case Field::rA:
+         mask |= 1u << instr.rA;
+         break;
+      case Field::rB:
+         mask |= 1u << instr.rB;
+         break;
+      case Field::rD:
+         mask |= 1u << instr.rD;
+         break;
+      case Field::rS:
+         mask |= 1u << instr.rS;
+         break;
+      default:
+         break;
+      }
+   }
+
+   return mask;
+}
+
+// Every iteration has to behave the same while memory does not change, so
+//   a register the body writes may only be read after it has been written
+//   in the same iteration.
+bool
+isIdleLoop(uint32_t start, uint32_t branch)
+{
+   if (start > branch || branch - start >= MaxIdleLoopSize * 4) {
+      return false;
+   }
+
+   auto instr = gMemory.read<Instruction>(branch);
+   auto data = gInstructionTable.decode(instr);
+
+   // Only a plain conditional branch back, a CTR decrement counts the loop
+   if (!data || data->id != InstructionID::bc || instr.lk || !get_bit<2>(instr.bo)) {
+      return false;
+   }
+
+   uint32_t bodyWrites = 0;
+
+   for (auto addr = start; addr < branch; addr += 4) {
+      instr = gMemory.read<Instruction>(addr);
+      data = gInstructionTable.decode(instr);
+
+      if (!data || !isIdleInstruction(data->id)) {
+         return false;
+      }
+
+      bodyWrites |= gprMask(data->write, instr);
+   }
+
+   uint32_t written = 0;
+
+   for (auto addr = start; addr < branch; addr += 4) {
+      instr = gMemory.read<Instruction>(addr);
+      data = gInstructionTable.decode(instr);
+
+      if (gprMask(data->read, instr) & bodyWrites & ~written) {
+         return false;
+      }
+
+      written |= gprMask(data->write, instr);
+   }
+
+   return true;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <cstdint>
+
+// Longest loop body isIdleLoop will look at, in instructions
+static const uint32_t MaxIdleLoopSize = 8;
+
+// Whether the loop from start up to the bc at branch only polls memory,
+//   so it can not exit until another core or an interrupt writes to it.
+bool
+isIdleLoop(uint32_t start, uint32_t branch);
@@ -68,6 +68,10 @@ struct InstructionTable
    void initialise();
    InstructionData *find(InstructionID instrId);
    InstructionData *decode(Instruction instr);
+
+   // Walks the opcode tree the flat decode tables are built from, only
+   //   used to check them.
+   InstructionData *decodeTree(Instruction instr);
    Instruction encode(InstructionID id);
    InstructionAlias *findAlias(InstructionData *data, Instruction instr);
    bool isA(InstructionID id, Instruction instr);
@@ -54,9 +54,30 @@ struct TableEntry
    std::vector<FieldMap> fieldMaps;
 };
 
+// Flat decode tables built from instructionTable.  The primary opcode
+//   indexes decodeTable, primaries whose next level only tests extended
+//   opcode fields then index a secondary table by bits 21-30.  Anything
+//   with more opcode fields to check keeps walking the tree from node.
+struct DecodeEntry
+{
+   InstructionData *instr = nullptr;
+   TableEntry *node = nullptr;
+};
+
+struct PrimaryDecodeEntry
+{
+   DecodeEntry entry;
+   std::vector<DecodeEntry> secondary;
+};
+
+static const uint32_t SecondaryTableBits = 10;
+// Bits 21-30 in PowerPC bit numbering, where xo1 is
+static const uint32_t SecondaryTableMask = make_bitmask<1, 10, uint32_t>();
+
 static std::vector<InstructionData> instructionData;
 static std::vector<InstructionAlias> aliasData;
 static TableEntry instructionTable;
+static PrimaryDecodeEntry decodeTable[64];
 
 static void
 initData();
@@ -64,6 +85,9 @@ initData();
 static void
 initTable();
 
+static void
+initDecodeTable();
+
 #define FLD(x, y, z, ...) {y, z},
 #define MRKR(x, ...) {-1, -1},
 static BitRange gFieldBits[] = {
@@ -124,13 +148,11 @@ InstructionTable::find(InstructionID instrId)
    return &instructionData[static_cast<size_t>(instrId)];
 }
 
-// Decode Instruction to InstructionData
-InstructionData *
-InstructionTable::decode(Instruction instr)
+// Continue decoding from a node of instructionTable, at each level the
+//   first field map with an entry for instr is followed.
+static InstructionData *
+decodeFrom(TableEntry *table, Instruction instr)
 {
-   TableEntry *table = &instructionTable;
-   InstructionData *data = nullptr;
-
    while (table) {
       for (auto &fieldMap : table->fieldMaps) {
          auto value = getFieldValue(fieldMap.field, instr);
@@ -149,6 +171,36 @@ InstructionTable::decode(Instruction instr)
    return nullptr;
 }
 
+static InstructionData *
+decodeEntry(const DecodeEntry &entry, Instruction instr)
+{
+   if (entry.node) {
+      return decodeFrom(entry.node, instr);
+   }
+
+   return entry.instr;
+}
+
+// Decode Instruction to InstructionData
+InstructionData *
+InstructionTable::decode(Instruction instr)
+{
+   auto &primary = decodeTable[instr.opcd];
+
+   if (primary.secondary.empty()) {
+      return decodeEntry(primary.entry, instr);
+   }
+
+   auto index = (instr.value & SecondaryTableMask) >> getFieldStart(Field::xo1);
+   return decodeEntry(primary.secondary[index], instr);
+}
+
+InstructionData *
+InstructionTable::decodeTree(Instruction instr)
+{
+   return decodeFrom(&instructionTable, instr);
+}
+
 InstructionAlias *
 InstructionTable::findAlias(InstructionData *data, Instruction instr)
 {
@@ -222,6 +274,7 @@ InstructionTable::initialise()
 {
    initData();
    initTable();
+   initDecodeTable();
 }
 
 // Initialise instructionTable
@@ -247,6 +300,68 @@ initTable()
    }
 }
 
+// Where decoding ends up after taking the first non empty child of node
+//   for instr, the same choice decodeFrom makes at one level.
+static DecodeEntry
+getDecodeEntry(TableEntry *node, Instruction instr)
+{
+   DecodeEntry result;
+   TableEntry *child = nullptr;
+
+   for (auto &fieldMap : node->fieldMaps) {
+      child = &fieldMap.children[getFieldValue(fieldMap.field, instr)];
+
+      if (child->instr || child->fieldMaps.size()) {
+         break;
+      }
+   }
+
+   if (child && child->fieldMaps.size()) {
+      result.node = child;
+   } else if (child) {
+      result.instr = child->instr;
+   }
+
+   return result;
+}
+
+// Initialise decodeTable from instructionTable
+void
+initDecodeTable()
+{
+   auto primaryOnly = Instruction { 0 };
+
+   for (auto opcd = 0u; opcd < 64; ++opcd) {
+      auto &primary = decodeTable[opcd];
+      primaryOnly.opcd = opcd;
+      primary.entry = getDecodeEntry(&instructionTable, primaryOnly);
+      primary.secondary.clear();
+
+      auto node = primary.entry.node;
+      if (!node) {
+         continue;
+      }
+
+      // The secondary table can only stand in for a level which looks at
+      //   nothing but bits 21-30
+      auto extendedOnly = true;
+      for (auto &fieldMap : node->fieldMaps) {
+         extendedOnly &= (getFieldBitmask(fieldMap.field) & ~SecondaryTableMask) == 0;
+      }
+
+      if (!extendedOnly) {
+         continue;
+      }
+
+      primary.secondary.resize(1 << SecondaryTableBits);
+
+      for (auto index = 0u; index < primary.secondary.size(); ++index) {
+         auto instr = Instruction { (opcd << getFieldStart(Field::opcd)) | (index << getFieldStart(Field::xo1)) };
+         primary.secondary[index] = getDecodeEntry(node, instr);
+      }
+   }
+}
+
 std::string cleanInsName(const std::string& name)
 {
    if (name[name.size() - 1] == '_') {
@@ -1,5 +1,9 @@
+#include <cstring>
+#include <map>
 #include <sstream>
+#include "bitutils.h"
 #include "disassembler.h"
+#include "idleloop.h"
 #include "interpreter.h"
 #include "instructiondata.h"
 #include "memory.h"
@@ -7,6 +11,7 @@
 #include "trace.h"
 #include "log.h"
 #include "debugcontrol.h"
+#include "debugger.h"
 #include "statedbg.h"
 
 Interpreter
@@ -51,27 +56,208 @@ bool Interpreter::hasInstruction(InstructionID id)
 
 void Interpreter::setJitMode(InterpJitMode val) {
    mJitMode = val;
+   reselectLoop();
 }
 
-void
-Interpreter::execute(ThreadState *state)
+void Interpreter::reselectLoop() {
+   mLoopGeneration++;
+}
+
+void Interpreter::setVerifyPeriod(uint32_t period) {
+   mVerifyPeriod = period ? period : 1;
+}
+
+void Interpreter::invalidatePage(uint32_t page) {
+   mCache.invalidatePage(page);
+}
+
+void Interpreter::clearDecodeCache() {
+   mCache.clear();
+}
+
+InterpreterCache::InterpreterCache() {
+   mTable = new std::atomic<Region *>[L1Size];
+   for (auto i = 0u; i < L1Size; ++i) {
+      mTable[i].store(nullptr, std::memory_order_relaxed);
+   }
+}
+
+InterpreterCache::~InterpreterCache() {
+   for (auto i = 0u; i < L1Size; ++i) {
+      delete mTable[i].load(std::memory_order_relaxed);
+   }
+
+   delete[] mTable;
+}
+
+bool InterpreterCache::decode(uint32_t addr, DecodedInstruction &decoded) {
+   auto &slot = mTable[addr >> 16];
+   auto region = slot.load(std::memory_order_acquire);
+
+   if (!region) {
+      auto created = new Region();
+      for (auto i = 0u; i < L2Size; ++i) {
+         created->entries[i].fptr.store(nullptr, std::memory_order_relaxed);
+      }
+
+      for (auto i = 0u; i < PagesPerRegion; ++i) {
+         created->decoded[i].store(false, std::memory_order_relaxed);
+         created->generation[i].store(0, std::memory_order_relaxed);
+      }
+
+      // Another core may have got here first
+      if (slot.compare_exchange_strong(region, created, std::memory_order_acq_rel)) {
+         region = created;
+      } else {
+         delete created;
+      }
+   }
+
+   // Protect before reading so a write from now on drops the entry.  The
+   //   flag is set by protectCodePage after the protection is in place, so
+   //   other cores keep taking this path until then.
+   auto pageIndex = (addr & 0xffff) / Memory::HostPageSize;
+   auto &generation = region->generation[pageIndex];
+   auto start = generation.load();
+   auto &pageDecoded = region->decoded[pageIndex];
+   if (!pageDecoded.load()) {
+      gJitManager.protectCodePage(addr / Memory::HostPageSize, &pageDecoded);
+   }
+
+   auto instr = gMemory.read<Instruction>(addr);
+   auto data = gInstructionTable.decode(instr);
+
+   if (!data) {
+      gLog->error("Could not decode instruction at {:08x} = {:08x}", addr, instr.value);
+      return false;
+   }
+
+   auto fptr = sInstructionMap[static_cast<size_t>(data->id)];
+
+   if (!fptr) {
+      gLog->error("Unimplemented interpreter instruction {}", data->name);
+      return false;
+   }
+
+   auto &entry = region->entries[(addr & 0xffff) >> 2];
+   entry.data = data;
+   entry.instr = instr;
+   entry.fptr.store(fptr);
+
+   // A write to the page since we started may have cleared the entry
+   //   before we stored it, drop it again so it gets decoded next time
+   if ((start & 1) || generation.load() != start) {
+      entry.fptr.store(nullptr);
+   }
+
+   decoded.fptr = fptr;
+   decoded.data = data;
+   decoded.instr = instr;
+   return true;
+}
+
+void InterpreterCache::invalidatePage(uint32_t page) {
+   auto region = mTable[page / PagesPerRegion].load(std::memory_order_acquire);
+   if (!region) {
+      return;
+   }
+
+   auto index = page % PagesPerRegion;
+   auto perPage = Memory::HostPageSize / 4;
+
+   region->generation[index]++;
+
+   for (auto i = index * perPage; i < (index + 1) * perPage; ++i) {
+      region->entries[i].fptr.store(nullptr);
+   }
+
+   region->decoded[index].store(false);
+   region->generation[index]++;
+}
+
+void InterpreterCache::clear() {
+   for (auto i = 0u; i < L1Size; ++i) {
+      if (mTable[i].load(std::memory_order_acquire)) {
+         for (auto page = 0u; page < PagesPerRegion; ++page) {
+            invalidatePage(i * PagesPerRegion + page);
+         }
+      }
+   }
+}
+
+// Interpreter loop variants, chosen by getLoopFlags
+static const unsigned LoopTraced = 1 << 0;
+static const unsigned LoopDebugged = 1 << 1;
+static const unsigned LoopJitModeShift = 2;
+static const unsigned LoopVariants = 16;
+
+unsigned
+Interpreter::getLoopFlags(ThreadState *state) const
 {
-   bool hasJumped = false;
+   auto flags = static_cast<unsigned>(mJitMode) << LoopJitModeShift;
+
+   if (state->tracer) {
+      flags |= LoopTraced;
+   }
+
+   if (gDebugger.isEnabled()) {
+      flags |= LoopDebugged;
+   }
+
+   return flags;
+}
+
+// Returns false when reselectLoop was called, so execute can switch to
+//   another variant.
+template<unsigned Flags>
+bool
+Interpreter::executeLoop(ThreadState *state, uint32_t generation)
+{
+   static const bool Traced = (Flags & LoopTraced) != 0;
+   static const bool Debugged = (Flags & LoopDebugged) != 0;
+   static const auto JitMode = static_cast<InterpJitMode>(Flags >> LoopJitModeShift);
+   static const bool UseJit = JitMode == InterpJitMode::Enabled || JitMode == InterpJitMode::Verify;
    bool forceJit = false;
+   auto pendingInterrupts = gProcessor.getPendingInterrupts();
+
+   // Last short backward branch target checked with isIdleLoop
+   uint32_t idleLoopAddr = 0;
+   bool idleLoop = false;
+
+   // Keeps JIT code this loop may still be running from being freed, no
+   //   code entered by this loop is running at the top of it.
+   JitCodeScope jitScope(state);
 
    while (state->nia != CALLBACK_ADDR) {
+      if (state->nia != state->cia + 4 && mLoopGeneration.load(std::memory_order_relaxed) != generation) {
+         return false;
+      }
+
+      if (UseJit || JitMode == InterpJitMode::Debug) {
+         jitScope.refresh();
+      }
+
       // TankTankTank decryptor fn
       //forceJit = state->nia >= 0x0250B648 && state->nia < 0x0250B8B8;
 
-      // Handle interrupts
-      gProcessor.handleInterrupt();
+      // Handle interrupts, only pending ones for this core need the call
+      if (pendingInterrupts->load(std::memory_order_relaxed) & state->interruptMask) {
+         gProcessor.handleInterrupt();
+      }
 
       // JIT Attempt!
-      if (forceJit || mJitMode == InterpJitMode::Enabled) {
+      if (forceJit || UseJit) {
          if (forceJit || state->nia != state->cia + 4) {
-            // We jumped, try to enter JIT
-            JitCode jitFn = gJitManager.get(state->nia);
+            // We jumped, try to enter JIT.  Cold targets are only counted
+            //   and get compiled in the background once they are hot.
+            JitCode jitFn = forceJit ? gJitManager.get(state->nia) : gJitManager.lookup(state->nia);
             if (jitFn) {
+               if (JitMode == InterpJitMode::Verify
+                && ++mVerifyCount % mVerifyPeriod == 0
+                && verifyBlock(state)) {
+                  continue;
+               }
+
                auto newNia = gJitManager.execute(state, jitFn);
                state->cia = 0;
                state->nia = newNia;
@@ -84,25 +270,24 @@ Interpreter::execute(ThreadState *state)
       state->cia = state->nia;
       state->nia = state->cia + 4;
 
-      gDebugControl.maybeBreak(state->cia, state, gProcessor.getCoreID());
-
-      auto instr = gMemory.read<Instruction>(state->cia);
-      auto data = gInstructionTable.decode(instr);
-
-      if (!data) {
-         gLog->error("Could not decode instruction at {:08x} = {:08x}", state->cia, instr.value);
+      if (Debugged) {
+         gDebugControl.maybeBreak(state->cia, state, gProcessor.getCoreID());
       }
-      assert(data);
 
-      auto trace = traceInstructionStart(instr, data, state);
-      auto fptr = sInstructionMap[static_cast<size_t>(data->id)];
+      DecodedInstruction decoded;
+      auto decodeOk = mCache.get(state->cia, decoded);
+      assert(decodeOk);
 
-      if (!fptr) {
-         gLog->error("Unimplemented interpreter instruction {}", data->name);
+      auto instr = decoded.instr;
+      auto data = decoded.data;
+      auto fptr = decoded.fptr;
+      Trace *trace = nullptr;
+
+      if (Traced) {
+         trace = traceInstructionStart(instr, data, state);
       }
-      assert(fptr);
 
-      if (mJitMode != InterpJitMode::Debug) {
+      if (JitMode != InterpJitMode::Debug) {
          fptr(state, instr);
       } else {
          // Save original state for debugging
@@ -149,8 +334,285 @@ Interpreter::execute(ThreadState *state)
          }
       }
 
-      traceInstructionEnd(trace, instr, data, state);
+      if (Traced) {
+         traceInstructionEnd(trace, instr, data, state);
+      }
+
+      if (data->id == InstructionID::bc && state->nia < state->cia && state->cia - state->nia < MaxIdleLoopSize * 4) {
+         if (state->nia != idleLoopAddr) {
+            idleLoopAddr = state->nia;
+            idleLoop = isIdleLoop(state->nia, state->cia);
+         }
+
+         if (idleLoop) {
+            gProcessor.idleLoop(state->nia);
+         }
+      }
    }
+
+   return true;
+}
+
+void
+Interpreter::execute(ThreadState *state)
+{
+   typedef bool (Interpreter::*LoopFunction)(ThreadState *, uint32_t);
+
+   // Indexed by getLoopFlags
+   static const LoopFunction loops[LoopVariants] = {
+      &Interpreter::executeLoop<0>, &Interpreter::executeLoop<1>,
+      &Interpreter::executeLoop<2>, &Interpreter::executeLoop<3>,
+      &Interpreter::executeLoop<4>, &Interpreter::executeLoop<5>,
+      &Interpreter::executeLoop<6>, &Interpreter::executeLoop<7>,
+      &Interpreter::executeLoop<8>, &Interpreter::executeLoop<9>,
+      &Interpreter::executeLoop<10>, &Interpreter::executeLoop<11>,
+      &Interpreter::executeLoop<12>, &Interpreter::executeLoop<13>,
+      &Interpreter::executeLoop<14>, &Interpreter::executeLoop<15>,
+   };
+
+   while (true) {
+      auto generation = mLoopGeneration.load();
+      auto loop = loops[getLoopFlags(state)];
+
+      if ((this->*loop)(state, generation)) {
+         break;
+      }
+   }
+}
+
+// Copies of guest pages from before a verified block first wrote to them
+using PageSnapshot = std::map<uint32_t, std::vector<uint8_t>>;
+
+// Longest any store writes, stmw and stswx from ea or dcbz from ea & ~31
+static const uint32_t MaxStoreSize = 160;
+
+// Instructions replayed before giving up on a block which loops for long
+static const uint32_t MaxVerifyInstructions = 0x100000;
+
+static uint8_t *
+getPage(uint32_t page)
+{
+   return reinterpret_cast<uint8_t *>(gMemory.base()) + page * Memory::HostPageSize;
+}
+
+static void
+snapshotPages(PageSnapshot &pages, uint32_t start, uint32_t size)
+{
+   auto first = start / Memory::HostPageSize;
+   auto last = (start + size - 1) / Memory::HostPageSize;
+
+   for (auto page = first; page <= last; ++page) {
+      if (pages.count(page) || !gMemory.valid(page * Memory::HostPageSize)) {
+         continue;
+      }
+
+      auto ptr = getPage(page);
+      pages[page].assign(ptr, ptr + Memory::HostPageSize);
+   }
+}
+
+static void
+restorePages(const PageSnapshot &pages)
+{
+   for (auto &page : pages) {
+      std::memcpy(getPage(page.first), page.second.data(), Memory::HostPageSize);
+   }
+}
+
+static bool
+isStore(InstructionID id)
+{
+   switch (id) {
+   case InstructionID::stb:
+   case InstructionID::stbu:
+   case InstructionID::stbx:
+   case InstructionID::stbux:
+   case InstructionID::sth:
+   case InstructionID::sthu:
+   case InstructionID::sthx:
+   case InstructionID::sthux:
+   case InstructionID::stw:
+   case InstructionID::stwu:
+   case InstructionID::stwx:
+   case InstructionID::stwux:
+   case InstructionID::sthbrx:
+   case InstructionID::stwbrx:
+   case InstructionID::stmw:
+   case InstructionID::stswi:
+   case InstructionID::stswx:
+   case InstructionID::stwcx:
+   case InstructionID::stfd:
+   case InstructionID::stfdu:
+   case InstructionID::stfdx:
+   case InstructionID::stfdux:
+   case InstructionID::stfiwx:
+   case InstructionID::stfs:
+   case InstructionID::stfsu:
+   case InstructionID::stfsx:
+   case InstructionID::stfsux:
+   case InstructionID::dcbz:
+   case InstructionID::dcbz_l:
+   case InstructionID::psq_st:
+   case InstructionID::psq_stu:
+   case InstructionID::psq_stx:
+   case InstructionID::psq_stux:
+      return true;
+   default:
+      return false;
+   }
+}
+
+static uint32_t
+getStoreAddress(ThreadState *state, Instruction instr, const InstructionData *data)
+{
+   uint32_t ea = instr.rA ? state->gpr[instr.rA] : 0;
+
+   for (auto field : data->read) {
+      if (field == Field::rB) {
+         ea += state->gpr[instr.rB];
+      } else if (field == Field::d) {
+         ea += sign_extend<16>(instr.d);
+      } else if (field == Field::qd) {
+         ea += sign_extend<12>(instr.qd);
+      }
+   }
+
+   return ea;
+}
+
+// Whether the JIT code for block carries on inside it after instr, this
+//   has to match the exits JitManager::gen emits.
+static bool
+continuesInBlock(const JitVerifyBlock &block, Instruction instr, const InstructionData *data, ThreadState *state)
+{
+   auto taken = state->nia != state->cia + 4;
+
+   switch (data->id) {
+   case InstructionID::b:
+   case InstructionID::bc:
+      if (!taken) {
+         break;
+      }
+
+      if (instr.lk) {
+         return false;
+      }
+
+      if (data->id == InstructionID::bc && !instr.aa && state->nia < state->cia && isIdleLoop(state->nia, state->cia)) {
+         return false;
+      }
+
+      return block.targets.count(state->nia) != 0;
+   case InstructionID::bcctr:
+   case InstructionID::bclr:
+      if (taken) {
+         return false;
+      }
+
+      break;
+   default:
+      break;
+   }
+
+   return state->nia < block.end;
+}
+
+// Run the block the way its JIT code would, up to the first exit
+static bool
+replayBlock(ThreadState *state, const JitVerifyBlock &block, PageSnapshot &pages)
+{
+   for (auto count = 0u; count < MaxVerifyInstructions; ++count) {
+      state->cia = state->nia;
+      state->nia = state->cia + 4;
+
+      auto instr = gMemory.read<Instruction>(state->cia);
+      auto data = gInstructionTable.decode(instr);
+      auto fptr = data ? sInstructionMap[static_cast<size_t>(data->id)] : nullptr;
+
+      if (!fptr) {
+         return false;
+      }
+
+      if (isStore(data->id)) {
+         snapshotPages(pages, getStoreAddress(state, instr, data) & ~31u, MaxStoreSize);
+      }
+
+      fptr(state, instr);
+
+      if (!continuesInBlock(block, instr, data, state)) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+// Run the JIT block at state->nia in the interpreter first, then put back
+//   the registers and the pages it wrote and run the JIT code, and compare.
+//   Other cores writing memory in between can show up as false failures.
+//   Returns false if the block was not run.
+bool
+Interpreter::verifyBlock(ThreadState *state)
+{
+   auto block = gJitManager.getVerify(state->nia);
+   if (!block) {
+      return false;
+   }
+
+   PageSnapshot original;
+   ThreadState istate = *state;
+
+   if (!replayBlock(&istate, *block, original)) {
+      restorePages(original);
+      return false;
+   }
+
+   PageSnapshot expected;
+   for (auto &page : original) {
+      auto ptr = getPage(page.first);
+      expected[page.first].assign(ptr, ptr + Memory::HostPageSize);
+   }
+
+   restorePages(original);
+
+   ThreadState jstate = *state;
+   jstate.nia = gJitManager.execute(&jstate, block->entry);
+   jstate.cia = 0;
+   istate.cia = 0;
+
+   std::vector<std::string> errors;
+   dbgStateCmp(&jstate, &istate, errors);
+
+   for (auto &page : expected) {
+      auto ptr = getPage(page.first);
+
+      for (auto i = 0u; i < Memory::HostPageSize; ++i) {
+         if (ptr[i] != page.second[i]) {
+            errors.push_back(fmt::format("Memory {:08x} (got:{:02x} expected:{:02x})",
+                                         page.first * Memory::HostPageSize + i, ptr[i], page.second[i]));
+            break;
+         }
+      }
+   }
+
+   mVerifiedBlocks++;
+
+   if (errors.empty()) {
+      *state = jstate;
+      return true;
+   }
+
+   // Carry on from the interpreter's results
+   mVerifyFailures++;
+   gLog->error("JIT verification failed for block {:08x} entered at {:08x}", block->start, state->nia);
+
+   for (auto &err : errors) {
+      gLog->error(err);
+   }
+
+   restorePages(expected);
+   *state = istate;
+   return true;
 }
 
 void
@@ -174,9 +636,12 @@ bool jit_fallback(PPCEmuAssembler& a, Instruction instr)
 
    //printf("JIT Fallback for `%s`\n", data->name);
 
+   a.flushGprCache();
+   a.storeCia();
    a.mov(a.zcx, a.state);
    a.mov(a.edx, (uint32_t)instr);
    a.call(asmjit::Ptr(fptr));
+   a.reloadGprCache();
    
    return true;
 }
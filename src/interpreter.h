@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <cstdint>
 #include <vector>
 #include <condition_variable>
@@ -17,10 +18,82 @@
 
 using instrfptr_t = void(*)(ThreadState*, Instruction);
 
+struct InstructionData;
+
+struct DecodedInstruction
+{
+   instrfptr_t fptr;
+   InstructionData *data;
+   Instruction instr;
+};
+
+// Predecoded guest code so the interpreter loop does not read and decode
+//   every instruction it executes, laid out like JitCodeTable.  Pages are
+//   write protected through JitManager::protectCodePage when first decoded
+//   and dropped by invalidatePage when written to.
+class InterpreterCache
+{
+public:
+   static const uint32_t L1Size = 0x10000;
+   static const uint32_t L2Size = 0x4000;
+   static const uint32_t PagesPerRegion = 16;
+
+   InterpreterCache();
+   ~InterpreterCache();
+
+   // Returns false if the instruction at addr can not be interpreted
+   bool get(uint32_t addr, DecodedInstruction &decoded)
+   {
+      auto region = mTable[addr >> 16].load(std::memory_order_acquire);
+
+      if (region) {
+         auto &entry = region->entries[(addr & 0xffff) >> 2];
+
+         if (auto fptr = entry.fptr.load(std::memory_order_acquire)) {
+            decoded.fptr = fptr;
+            decoded.data = entry.data;
+            decoded.instr = entry.instr;
+            return true;
+         }
+      }
+
+      return decode(addr, decoded);
+   }
+
+   // page is a Memory::HostPageSize page number
+   void invalidatePage(uint32_t page);
+
+   // Existing regions are only reset as other cores may be reading them
+   void clear();
+
+private:
+   struct Entry
+   {
+      std::atomic<instrfptr_t> fptr;
+      InstructionData *data;
+      Instruction instr;
+   };
+
+   struct Region
+   {
+      Entry entries[L2Size];
+      std::atomic<bool> decoded[PagesPerRegion];
+
+      // Odd while invalidatePage is clearing the page, which JitManager
+      //   only does with its lock held
+      std::atomic<uint32_t> generation[PagesPerRegion];
+   };
+
+   bool decode(uint32_t addr, DecodedInstruction &decoded);
+
+   std::atomic<Region *> *mTable;
+};
+
 enum class InterpJitMode {
    Enabled,
    Disabled,
-   Debug
+   Debug,
+   Verify
 };
 
 class Interpreter
@@ -38,9 +111,42 @@ public:
       return mJitMode;
    }
 
+   // In InterpJitMode::Verify, every period'th JIT block entry is also run
+   //   in the interpreter and the results compared.
+   void setVerifyPeriod(uint32_t period);
+
+   uint64_t getVerifiedBlocks() const {
+      return mVerifiedBlocks;
+   }
+
+   uint64_t getVerifyFailures() const {
+      return mVerifyFailures;
+   }
+
+   // Called by JitManager when guest code changes
+   void invalidatePage(uint32_t page);
+   void clearDecodeCache();
+
+   // Called when the debugger, a tracer or the JIT mode changes, running
+   //   loops switch to the matching variant at their next branch.
+   void reselectLoop();
+
 private:
    void execute(ThreadState *state);
+   unsigned getLoopFlags(ThreadState *state) const;
+
+   template<unsigned Flags>
+   bool executeLoop(ThreadState *state, uint32_t generation);
+
+   bool verifyBlock(ThreadState *state);
+
    InterpJitMode mJitMode;
+   InterpreterCache mCache;
+   uint32_t mVerifyPeriod = 1;
+   std::atomic<uint64_t> mVerifyCount { 0 };
+   std::atomic<uint64_t> mVerifiedBlocks { 0 };
+   std::atomic<uint64_t> mVerifyFailures { 0 };
+   std::atomic<uint32_t> mLoopGeneration { 0 };
 
 public:
    static void RegisterFunctions();
@@ -161,7 +161,7 @@ fmul(ThreadState *state, Instruction instr)
 {
    double a, b, d;
    a = state->fpr[instr.frA].paired0;
-   b = state->fpr[instr.frB].paired0;
+   b = state->fpr[instr.frC].paired0;
 
    state->fpscr.vximz = is_infinity(a) && is_zero(b);
    state->fpscr.vxsnan = is_signalling_nan(a) || is_signalling_nan(b);
@@ -402,7 +402,7 @@ fctiw(ThreadState *state, Instruction instr)
    if (b > static_cast<double>(0x7FFFFFFF)) {
       bi = 0x7FFFFFFF;
       state->fpscr.vxcvi = 1;
-   } else if (b < static_cast<double>(0x80000000)) {
+   } else if (b < -static_cast<double>(0x80000000)) {
       bi = 0x80000000;
       state->fpscr.vxcvi = 1;
    } else {
@@ -445,7 +445,7 @@ fctiwz(ThreadState *state, Instruction instr)
    if (b > static_cast<double>(0x7FFFFFFF)) {
       bi = 0x7FFFFFFF;
       state->fpscr.vxcvi = 1;
-   } else if (b < static_cast<double>(0x80000000)) {
+   } else if (b < -static_cast<double>(0x80000000)) {
       bi = 0x80000000;
       state->fpscr.vxcvi = 1;
    } else {
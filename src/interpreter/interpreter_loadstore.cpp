@@ -649,15 +649,15 @@ template<typename Type>
 static inline double
 clamp(double value)
 {
-   double min = static_cast<double>(std::numeric_limits<uint8_t>::min());
-   double max = static_cast<double>(std::numeric_limits<uint8_t>::max());
+   double min = static_cast<double>(std::numeric_limits<Type>::min());
+   double max = static_cast<double>(std::numeric_limits<Type>::max());
    return std::max(min, std::min(value, max));
 }
 
 static void
 quantize(uint32_t ea, double value, QuantizedDataType type, uint32_t scale)
 {
-   double scaleValue = dequantizeTable[scale];
+   double scaleValue = quantizeTable[scale];
 
    switch (type) {
    case QuantizedDataType::Floating:
@@ -803,8 +803,8 @@ psqStore(ThreadState *state, Instruction instr)
    }
 
    c = 4;
-   stt = static_cast<QuantizedDataType>(state->gqr[instr.qi].st_type);
-   sts = state->gqr[instr.qi].st_scale;
+   stt = static_cast<QuantizedDataType>(state->gqr[i].st_type);
+   sts = state->gqr[i].st_scale;
 
    if (stt == QuantizedDataType::Unsigned8 || stt == QuantizedDataType::Signed8) {
       c = 1;
@@ -815,7 +815,7 @@ psqStore(ThreadState *state, Instruction instr)
    s0 = state->fpr[instr.frS].paired0;
    s1 = state->fpr[instr.frS].paired1;
 
-   if (instr.qw == 0) {
+   if (w == 0) {
       quantize(ea, s0, stt, sts);
       quantize(ea + c, s1, stt, sts);
    } else {
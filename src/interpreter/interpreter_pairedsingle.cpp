@@ -336,14 +336,14 @@ mulGeneric(ThreadState *state, Instruction instr)
    a1 = state->fpr[instr.frA].paired1;
 
    if (flags & MultiplyPaired) {
-      b0 = state->fpr[instr.frB].paired0;
-      b1 = state->fpr[instr.frB].paired1;
+      b0 = state->fpr[instr.frC].paired0;
+      b1 = state->fpr[instr.frC].paired1;
    } else if (flags & MultiplyScalar0) {
-      b0 = state->fpr[instr.frB].paired0;
-      b1 = state->fpr[instr.frB].paired0;
+      b0 = state->fpr[instr.frC].paired0;
+      b1 = state->fpr[instr.frC].paired0;
    } else if (flags & MultiplyScalar1) {
-      b0 = state->fpr[instr.frB].paired1;
-      b1 = state->fpr[instr.frB].paired1;
+      b0 = state->fpr[instr.frC].paired1;
+      b1 = state->fpr[instr.frC].paired1;
    }
 
    state->fpscr.vximz |=
@@ -1,7 +1,16 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "crc32.h"
+#include "idleloop.h"
 #include "jit.h"
+#include "jit_float.h"
 #include "log.h"
 #include "interpreter.h"
+#include "platform.h"
 #include "instructiondata.h"
+#include "processor.h"
+#include "strutils.h"
 
 JitManager
 gJitManager;
@@ -51,36 +60,359 @@ bool JitManager::hasInstruction(InstructionID id)
    }
 }
 
+// Guest writes to a page holding compiled code fault here
+static bool
+onCodeWrite(ppcaddr_t address)
+{
+   return gJitManager.invalidateRange(address, 1);
+}
+
+// Guest accesses to unmapped memory from JIT code fault here
+static bool
+onAccessFault(uintptr_t &hostPc, ppcaddr_t address, bool write)
+{
+   return gJitManager.handleAccessFault(hostPc, address, write);
+}
+
+static const std::pair<const char *, uint32_t>
+sCpuFeatureNames[] = {
+   { "movbe", JitCpuMovbe },
+   { "lzcnt", JitCpuLzcnt },
+   { "bmi1", JitCpuBmi1 },
+   { "bmi2", JitCpuBmi2 },
+   { "avx", JitCpuAvx },
+};
+
+static uint32_t
+detectCpuFeatures()
+{
+   uint32_t info[4];
+   uint32_t features = 0;
+
+   platform::cpuid(0, 0, info);
+   auto maxLeaf = info[0];
+
+   platform::cpuid(1, 0, info);
+
+   if (info[2] & (1 << 22)) {
+      features |= JitCpuMovbe;
+   }
+
+   // AVX also needs the OS to save the upper ymm state
+   if ((info[2] & (1 << 28)) && (info[2] & (1 << 27)) && (platform::xgetbv(0) & 6) == 6) {
+      features |= JitCpuAvx;
+   }
+
+   if (maxLeaf >= 7) {
+      platform::cpuid(7, 0, info);
+
+      if (info[1] & (1 << 3)) {
+         features |= JitCpuBmi1;
+      }
+
+      if (info[1] & (1 << 8)) {
+         features |= JitCpuBmi2;
+      }
+   }
+
+   platform::cpuid(0x80000000, 0, info);
+
+   if (info[0] >= 0x80000001) {
+      platform::cpuid(0x80000001, 0, info);
+
+      if (info[2] & (1 << 5)) {
+         features |= JitCpuLzcnt;
+      }
+   }
+
+   return features;
+}
+
+bool JitManager::disableCpuFeatures(const std::string &names) {
+   std::vector<std::string> list;
+   split_string(names, ',', list);
+
+   for (auto &name : list) {
+      auto found = false;
+
+      if (name == "all") {
+         mDisabledCpuFeatures = ~0u;
+         continue;
+      }
+
+      for (auto &feature : sCpuFeatureNames) {
+         if (name == feature.first) {
+            mDisabledCpuFeatures |= feature.second;
+            found = true;
+         }
+      }
+
+      if (!found) {
+         gLog->error("Unknown JIT cpu feature {}", name);
+         return false;
+      }
+   }
+
+   return true;
+}
+
 bool JitManager::initialise() {
+   std::string names;
+   mCpuFeatures = detectCpuFeatures() & ~mDisabledCpuFeatures;
+
+   for (auto &feature : sCpuFeatureNames) {
+      if (mCpuFeatures & feature.second) {
+         names += names.empty() ? feature.first : std::string { " " } + feature.first;
+      }
+   }
+
+   gLog->info("JIT using host cpu features: {}", names.empty() ? "none" : names);
+
+   if (!mPerfMapPath.empty()) {
+      mPerfMap.open(mPerfMapPath);
+   }
+
    initStubs();
+   gMemory.setWriteFaultHandler(&onCodeWrite);
+   gMemory.setAccessFaultHandler(&onAccessFault);
+
+   // Only lookup queues blocks for the background compiler
+   auto mode = gInterpreter.getJitMode();
+   if (mode == InterpJitMode::Enabled || mode == InterpJitMode::Verify) {
+      mCompileThread = std::thread(&JitManager::compileThreadEntry, this);
+   }
+
    return true;
 }
 
+// Stops the background compiler, pending requests are dropped
+void JitManager::shutdown() {
+   if (mCompileThread.joinable()) {
+      {
+         std::lock_guard<std::mutex> lock(mQueueMutex);
+         mStopCompileThread = true;
+      }
+
+      mQueueCond.notify_all();
+      mCompileThread.join();
+   }
+}
+
+// Clears ZF if the core running this ThreadState has an interrupt pending,
+//   clobbers ptr and reg which are the 64 and 32 bit names of one register.
+static void
+testPendingInterrupt(PPCEmuAssembler& a, const asmjit::X86GpReg& ptr, const asmjit::X86GpReg& reg)
+{
+   a.mov(ptr, asmjit::Ptr(gProcessor.getPendingInterrupts()));
+   a.mov(reg, asmjit::X86Mem(ptr, 0, 4));
+   a.and_(reg, a.ppcinterruptMask);
+}
+
 void JitManager::initStubs() {
    PPCEmuAssembler a(mRuntime);
 
    asmjit::Label introLabel(a);
    asmjit::Label extroLabel(a);
+   asmjit::Label dispatchLabel(a);
 
    a.bind(introLabel);
    a.push(a.zbx);
    a.push(a.zdi);
    a.push(a.zsi);
+   a.push(asmjit::x86::r12);
+   a.push(asmjit::x86::r13);
+   a.push(asmjit::x86::r14);
+   a.push(asmjit::x86::r15);
    a.sub(a.zsp, 0x30);
    a.mov(a.zbx, a.zcx);
    a.mov(a.zsi, static_cast<uint64_t>(gMemory.base()));
    a.jmp(a.zdx);
 
    a.bind(extroLabel);
+
+   if (mProfileMode == JitProfileMode::Time) {
+      // Charge the last block entered for the time until JIT code is left,
+      //   eax holds the next guest address.
+      asmjit::Label noBlock(a);
+      a.mov(asmjit::x86::r8d, a.eax);
+      a.mov(a.zcx, a.ppcprofileBlock);
+      a.test(a.zcx, a.zcx);
+      a.je(noBlock);
+      a.rdtsc();
+      a.shl(a.zdx, 32);
+      a.or_(a.zax, a.zdx);
+      a.sub(a.zax, a.ppcprofileStart);
+      a.add(asmjit::X86Mem(a.zcx, offsetof(JitProfileEntry, cycles), 8), a.zax);
+      a.mov(a.ppcprofileBlock, 0);
+      a.bind(noBlock);
+      a.mov(a.eax, asmjit::x86::r8d);
+   }
+
    a.add(a.zsp, 0x30);
+   a.pop(asmjit::x86::r15);
+   a.pop(asmjit::x86::r14);
+   a.pop(asmjit::x86::r13);
+   a.pop(asmjit::x86::r12);
    a.pop(a.zsi);
    a.pop(a.zdi);
    a.pop(a.zbx);
    a.ret();
 
+   // Jump to the block for the guest address in eax without leaving JIT
+   //   code, falls back to the finale when the address has not been
+   //   compiled yet or there is an interrupt to handle.
+   a.bind(dispatchLabel);
+   a.mov(a.edx, a.eax);
+   a.shr(a.edx, 16);
+   a.mov(a.zcx, asmjit::Ptr(mBlocks.root()));
+   a.mov(a.zcx, asmjit::x86::ptr(a.zcx, a.zdx, 3));
+   a.test(a.zcx, a.zcx);
+   a.jz(extroLabel);
+   a.mov(a.edx, a.eax);
+   a.and_(a.edx, 0xfffc);
+   a.mov(a.zcx, asmjit::x86::ptr(a.zcx, a.zdx, 1));
+   a.cmp(a.zcx, JitCodeTable::Failed);
+   a.jbe(extroLabel);
+   testPendingInterrupt(a, a.zdx, a.edx);
+   a.jne(extroLabel);
+   a.jmp(a.zcx);
+
    auto basePtr = a.make();
    mCallFn = asmjit_cast<JitCall>(basePtr, a.getLabelOffset(introLabel));
    mFinaleFn = asmjit_cast<JitCall>(basePtr, a.getLabelOffset(extroLabel));
+   mDispatchFn = asmjit_cast<JitCall>(basePtr, a.getLabelOffset(dispatchLabel));
+}
+
+JitCodeTable::JitCodeTable() {
+   mTable = new std::atomic<Entry *>[L1Size];
+   for (auto i = 0u; i < L1Size; ++i) {
+      mTable[i].store(nullptr, std::memory_order_relaxed);
+   }
+}
+
+JitCodeTable::~JitCodeTable() {
+   clear();
+   delete[] mTable;
+}
+
+JitCode JitCodeTable::get(uint32_t addr) const {
+   auto page = mTable[addr >> 16].load(std::memory_order_acquire);
+   if (!page) {
+      return nullptr;
+   }
+
+   auto code = page[(addr & 0xffff) >> 2].load(std::memory_order_acquire);
+   if (reinterpret_cast<uintptr_t>(code) == Failed) {
+      return nullptr;
+   }
+
+   return code;
+}
+
+bool JitCodeTable::contains(uint32_t addr) const {
+   auto page = mTable[addr >> 16].load(std::memory_order_acquire);
+   return page && page[(addr & 0xffff) >> 2].load(std::memory_order_acquire);
+}
+
+JitCodeTable::Entry &JitCodeTable::entry(uint32_t addr) {
+   auto &slot = mTable[addr >> 16];
+   auto page = slot.load(std::memory_order_acquire);
+
+   if (!page) {
+      page = new Entry[L2Size];
+      for (auto i = 0u; i < L2Size; ++i) {
+         page[i].store(nullptr, std::memory_order_relaxed);
+      }
+
+      slot.store(page, std::memory_order_release);
+   }
+
+   return page[(addr & 0xffff) >> 2];
+}
+
+void JitCodeTable::set(uint32_t addr, JitCode code) {
+   entry(addr).store(code, std::memory_order_release);
+}
+
+void JitCodeTable::setFailed(uint32_t addr) {
+   entry(addr).store(reinterpret_cast<JitCode>(Failed), std::memory_order_release);
+}
+
+void JitCodeTable::erase(uint32_t addr) {
+   auto page = mTable[addr >> 16].load(std::memory_order_acquire);
+   if (page) {
+      page[(addr & 0xffff) >> 2].store(nullptr, std::memory_order_release);
+   }
+}
+
+void JitCodeTable::clear() {
+   for (auto i = 0u; i < L1Size; ++i) {
+      delete[] mTable[i].load(std::memory_order_relaxed);
+      mTable[i].store(nullptr, std::memory_order_relaxed);
+   }
+}
+
+JitCounterTable::JitCounterTable() {
+   mTable = new std::atomic<Counter *>[JitCodeTable::L1Size];
+   for (auto i = 0u; i < JitCodeTable::L1Size; ++i) {
+      mTable[i].store(nullptr, std::memory_order_relaxed);
+   }
+}
+
+JitCounterTable::~JitCounterTable() {
+   clear();
+   delete[] mTable;
+}
+
+JitCounterTable::Counter &JitCounterTable::getCounter(uint32_t addr) {
+   auto &slot = mTable[addr >> 16];
+   auto page = slot.load(std::memory_order_acquire);
+
+   if (!page) {
+      auto newPage = new Counter[JitCodeTable::L2Size];
+      for (auto i = 0u; i < JitCodeTable::L2Size; ++i) {
+         newPage[i].store(0, std::memory_order_relaxed);
+      }
+
+      // Another core may allocate the same page at the same time
+      if (slot.compare_exchange_strong(page, newPage, std::memory_order_acq_rel)) {
+         page = newPage;
+      } else {
+         delete[] newPage;
+      }
+   }
+
+   return page[(addr & 0xffff) >> 2];
+}
+
+uint32_t JitCounterTable::increment(uint32_t addr) {
+   return getCounter(addr).fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void JitCounterTable::seed(uint32_t addr, uint32_t count) {
+   auto &counter = getCounter(addr);
+   auto value = counter.load(std::memory_order_relaxed);
+
+   while (value < count && !counter.compare_exchange_weak(value, count, std::memory_order_relaxed)) {
+   }
+}
+
+void JitCounterTable::reset(uint32_t addr) {
+   auto page = mTable[addr >> 16].load(std::memory_order_acquire);
+   if (page) {
+      page[(addr & 0xffff) >> 2].store(0, std::memory_order_relaxed);
+   }
+}
+
+void JitCounterTable::clear() {
+   for (auto i = 0u; i < JitCodeTable::L1Size; ++i) {
+      auto page = mTable[i].load(std::memory_order_acquire);
+      if (page) {
+         for (auto j = 0u; j < JitCodeTable::L2Size; ++j) {
+            page[j].store(0, std::memory_order_relaxed);
+         }
+      }
+   }
 }
 
 enum BoBits
@@ -98,6 +430,189 @@ enum BcFlags
    BcBranchCTR = 1 << 3
 };
 
+// Leave the block for a known guest address.  The jump goes through a
+//   slot which points at the finale until linkBlock patches it to enter
+//   the target block directly.
+static void
+jumpToGuest(PPCEmuAssembler& a, uint32_t target, JitFinale finaleFn)
+{
+   asmjit::Label interruptExit(a);
+   asmjit::Label slot(a);
+
+   a.mov(a.eax, target);
+   a.flushGprCache();
+
+   // Go back to the interpreter loop if there is an interrupt to handle
+   testPendingInterrupt(a, a.zcx, a.ecx);
+   a.jne(interruptExit);
+   a.jmp(asmjit::x86::ptr(slot));
+
+   a.bind(interruptExit);
+   a.jmp(asmjit::Ptr(finaleFn));
+
+   auto finale = reinterpret_cast<uint64_t>(finaleFn);
+   a.align(asmjit::kAlignData, 8);
+   a.bind(slot);
+   a.embed(&finale, sizeof(finale));
+
+   a.blockLinks.emplace_back(target, slot);
+}
+
+// Count an entry into a block and, when timing, charge the cycles since
+//   the previous block entry on this thread to that block.  Clobbers rax,
+//   rcx and rdx.
+static void
+genProfileEntry(PPCEmuAssembler& a, JitProfileEntry *profile, JitProfileMode mode)
+{
+   if (mode == JitProfileMode::Time) {
+      asmjit::Label noPrevious(a);
+      a.rdtsc();
+      a.shl(a.zdx, 32);
+      a.or_(a.zax, a.zdx);
+      a.mov(a.zcx, a.ppcprofileBlock);
+      a.test(a.zcx, a.zcx);
+      a.je(noPrevious);
+      a.mov(a.zdx, a.zax);
+      a.sub(a.zdx, a.ppcprofileStart);
+      a.add(asmjit::X86Mem(a.zcx, offsetof(JitProfileEntry, cycles), 8), a.zdx);
+      a.bind(noPrevious);
+      a.mov(a.ppcprofileStart, a.zax);
+   }
+
+   a.mov(a.zax, asmjit::Ptr(profile));
+   a.inc(asmjit::X86Mem(a.zax, offsetof(JitProfileEntry, count), 8));
+
+   if (mode == JitProfileMode::Time) {
+      a.mov(a.ppcprofileBlock, a.zax);
+   }
+}
+
+// Record a call returning to lr on the shadow return stack, if this block
+//   has an entry point for lr.  Clobbers rcx and rdx.
+static void
+pushReturnStack(PPCEmuAssembler& a, uint32_t lr, const std::atomic<uint32_t> *generation)
+{
+   auto resume = a.entryLabels.find(lr);
+   if (a.isolated || resume == a.entryLabels.end()) {
+      return;
+   }
+
+   a.mov(a.edx, a.ppcreturnStackTop);
+   a.inc(a.edx);
+   a.and_(a.edx, ReturnStackSize - 1);
+   a.mov(a.ppcreturnStackTop, a.edx);
+   a.shl(a.edx, 4);
+   a.lea(a.zcx, asmjit::x86::ptr(a.zbx, a.zdx, 0, offsetof(ThreadState, returnStack)));
+   a.mov(asmjit::X86Mem(a.zcx, offsetof(ReturnStackEntry, lr), 4), lr);
+   a.mov(a.zdx, asmjit::Ptr(generation));
+   a.mov(a.edx, asmjit::X86Mem(a.zdx, 0, 4));
+   a.mov(asmjit::X86Mem(a.zcx, offsetof(ReturnStackEntry, generation), 4), a.edx);
+   a.lea(a.zdx, asmjit::x86::ptr(resume->second));
+   a.mov(asmjit::X86Mem(a.zcx, offsetof(ReturnStackEntry, host), 8), a.zdx);
+}
+
+// Jump back into the caller if the top of the shadow return stack is for
+//   the guest address in eax and its code is still current, otherwise fall
+//   through with eax intact.  The GPR cache must already be flushed.
+//   Clobbers rcx and rdx.
+static void
+popReturnStack(PPCEmuAssembler& a, const std::atomic<uint32_t> *generation)
+{
+   asmjit::Label miss(a);
+
+   // Masked as code tests start from a ThreadState filled with 0xFF
+   a.mov(a.edx, a.ppcreturnStackTop);
+   a.and_(a.edx, ReturnStackSize - 1);
+   a.shl(a.edx, 4);
+   a.lea(a.zcx, asmjit::x86::ptr(a.zbx, a.zdx, 0, offsetof(ThreadState, returnStack)));
+   a.cmp(asmjit::X86Mem(a.zcx, offsetof(ReturnStackEntry, lr), 4), a.eax);
+   a.jne(miss);
+   a.mov(a.zdx, asmjit::Ptr(generation));
+   a.mov(a.edx, asmjit::X86Mem(a.zdx, 0, 4));
+   a.cmp(asmjit::X86Mem(a.zcx, offsetof(ReturnStackEntry, generation), 4), a.edx);
+   a.jne(miss);
+
+   // Let the dispatcher leave JIT code if there is an interrupt to handle
+   testPendingInterrupt(a, a.zdx, a.edx);
+   a.jne(miss);
+
+   a.sub(a.ppcreturnStackTop, 1);
+   a.and_(a.ppcreturnStackTop, ReturnStackSize - 1);
+   a.jmp(asmjit::X86Mem(a.zcx, offsetof(ReturnStackEntry, host), 8));
+
+   a.bind(miss);
+}
+
+static void
+jitIdleLoop(uint32_t addr)
+{
+   gProcessor.idleLoop(addr);
+}
+
+static void
+jitFillInlineCache(JitInlineCache *cache, uint32_t target)
+{
+   gJitManager.fillInlineCache(cache, target);
+}
+
+// Jump to the block for the guest address in eax through an inline cache
+//   of the targets this site has seen, a miss records the target while the
+//   cache has room and then goes through the dispatcher.  The GPR cache
+//   must already be flushed.
+static void
+jumpToInlineCache(PPCEmuAssembler& a, uint32_t cia, JitFinale finaleFn, JitFinale dispatchFn)
+{
+   asmjit::Label cacheLbl(a);
+   asmjit::Label dispatchLbl(a);
+
+   testPendingInterrupt(a, a.zcx, a.ecx);
+   a.jne(dispatchLbl);
+
+   for (auto i = 0u; i < JIT_INLINE_CACHE_SIZE; ++i) {
+      asmjit::Label nextLbl(a);
+      a.cmp(a.eax, asmjit::x86::ptr(cacheLbl, offsetof(JitInlineCache, targets) + i * 4, 4));
+      a.jne(nextLbl);
+
+      if (a.profiling) {
+         a.inc(asmjit::x86::ptr(cacheLbl, offsetof(JitInlineCache, hits), 8));
+      }
+
+      a.jmp(asmjit::x86::ptr(cacheLbl, offsetof(JitInlineCache, hosts) + i * 8, 8));
+      a.bind(nextLbl);
+   }
+
+   if (a.profiling) {
+      a.inc(asmjit::x86::ptr(cacheLbl, offsetof(JitInlineCache, misses), 8));
+   }
+
+   a.cmp(asmjit::x86::ptr(cacheLbl, offsetof(JitInlineCache, used), 4), JIT_INLINE_CACHE_SIZE);
+   a.jae(dispatchLbl);
+   a.mov(asmjit::x86::edi, a.eax);
+   a.lea(a.zcx, asmjit::x86::ptr(cacheLbl));
+   a.mov(a.edx, a.eax);
+   a.mov(a.zax, asmjit::Ptr(&jitFillInlineCache));
+   a.call(a.zax);
+   a.mov(a.eax, asmjit::x86::edi);
+
+   a.bind(dispatchLbl);
+   a.jmp(asmjit::Ptr(dispatchFn));
+
+   JitInlineCache cache;
+   std::memset(&cache, 0, sizeof(cache));
+   cache.cia = cia;
+
+   for (auto i = 0u; i < JIT_INLINE_CACHE_SIZE; ++i) {
+      cache.targets[i] = JitInlineCache::Empty;
+      cache.hosts[i] = finaleFn;
+   }
+
+   a.align(asmjit::kAlignData, 8);
+   a.bind(cacheLbl);
+   a.embed(&cache, sizeof(cache));
+
+   a.inlineCaches.emplace_back(cia, cacheLbl);
+}
+
 bool JitManager::jit_b(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels)
 {
    uint32_t nia = sign_extend<26>(instr.li << 2);
@@ -108,9 +623,9 @@ bool JitManager::jit_b(PPCEmuAssembler& a, Instruction instr, uint32_t cia, cons
    if (instr.lk) {
       a.mov(a.eax, cia + 4u);
       a.mov(a.ppclr, a.eax);
+      pushReturnStack(a, cia + 4u, &mGeneration);
 
-      a.mov(a.eax, nia);
-      a.jmp(asmjit::Ptr(mFinaleFn));
+      jumpToGuest(a, nia, mFinaleFn);
       return true;
    }
 
@@ -118,8 +633,7 @@ bool JitManager::jit_b(PPCEmuAssembler& a, Instruction instr, uint32_t cia, cons
    if (i != jumpLabels.end()) {
       a.jmp(i->second);
    } else {
-      a.mov(a.eax, nia);
-      a.jmp(asmjit::Ptr(mFinaleFn));
+      jumpToGuest(a, nia, mFinaleFn);
    }
 
    return true;
@@ -127,7 +641,7 @@ bool JitManager::jit_b(PPCEmuAssembler& a, Instruction instr, uint32_t cia, cons
 
 template<unsigned flags>
 static bool
-bcGeneric(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels, JitFinale finaleFn)
+bcGeneric(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels, JitFinale finaleFn, JitFinale dispatchFn, const std::atomic<uint32_t> *generation)
 {
    uint32_t bo = instr.bo;
    asmjit::Label doCondFailLbl(a);
@@ -149,8 +663,19 @@ bcGeneric(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMa
       }
    }
 
+   // Is the CR field we test still in the host flags from the compare?
+   bool crFused = false;
+
    if (flags & BcCheckCond) {
-      if (!get_bit<NoCheckCond>(bo)) {
+      if (!get_bit<NoCheckCond>(bo) && a.pendingCrField == static_cast<int>(instr.bi / 4)) {
+         assert(!(flags & BcCheckCtr) || get_bit<NoCheckCtr>(bo));
+         jumpOnCRB(a, instr.bi % 4, !get_bit<CondValue>(bo), a.pendingCrUnsigned, doCondFailLbl);
+         crFused = true;
+
+         if (a.crLiveTaken) {
+            setCRFFromFlags(a, a.pendingCrField, a.pendingCrUnsigned);
+         }
+      } else if (!get_bit<NoCheckCond>(bo)) {
          //auto crb = get_bit(state->cr.value, 31 - instr.bi);
          //auto crv = get_bit<CondValue>(bo);
          //cond_ok = (crb == crv);
@@ -167,134 +692,1102 @@ bcGeneric(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMa
       }
    }
 
+   // Read the target before a blrl overwrites LR
+   if (flags & BcBranchCTR) {
+      a.mov(a.eax, a.ppcctr);
+      a.and_(a.eax, ~0x3);
+   } else if (flags & BcBranchLR) {
+      a.mov(a.eax, a.ppclr);
+      a.and_(a.eax, ~0x3);
+   }
+
    if (instr.lk) {
-      a.mov(a.eax, cia + 4);
-      a.mov(a.ppclr, a.eax);
+      a.mov(a.ppclr, cia + 4);
+      pushReturnStack(a, cia + 4, generation);
    }
 
    // Make sure no JMP related instructions end up above
    //   this if-block as we use a JMP instruction with
    //   early exit in the else block...
    if (flags & BcBranchCTR) {
-      a.mov(a.eax, a.ppcctr);
-      a.and_(a.eax, ~0x3);
-      a.jmp(asmjit::Ptr(finaleFn));
+      a.flushGprCache();
+
+      if (a.isolated) {
+         a.jmp(asmjit::Ptr(finaleFn));
+      } else {
+         jumpToInlineCache(a, cia, finaleFn, dispatchFn);
+      }
    } else if (flags & BcBranchLR) {
-      a.mov(a.eax, a.ppclr);
-      a.and_(a.eax, ~0x3);
-      a.jmp(asmjit::Ptr(finaleFn));
+      a.flushGprCache();
+
+      if (a.isolated) {
+         a.jmp(asmjit::Ptr(finaleFn));
+      } else {
+         if (!instr.lk) {
+            popReturnStack(a, generation);
+         }
+
+         a.jmp(asmjit::Ptr(dispatchFn));
+      }
    } else {
       uint32_t nia = cia + sign_extend<16>(instr.bd << 2);
       auto i = jumpLabels.find(nia);
-      if (i != jumpLabels.end()) {
+      if (a.idleLoop) {
+         // Leave through jumpToGuest so pending interrupts get handled
+         a.flushGprCache();
+         a.storeCia();
+         a.mov(a.ecx, nia);
+         a.mov(a.zax, asmjit::Ptr(&jitIdleLoop));
+         a.call(a.zax);
+         a.reloadGprCache();
+         jumpToGuest(a, nia, finaleFn);
+      } else if (i != jumpLabels.end()) {
          a.jmp(i->second);
       } else {
-         a.mov(a.eax, nia);
-         a.jmp(asmjit::Ptr(finaleFn));
+         jumpToGuest(a, nia, finaleFn);
       }
    }
 
    a.bind(doCondFailLbl);
+
+   if (crFused && a.crLiveFallthrough) {
+      setCRFFromFlags(a, a.pendingCrField, a.pendingCrUnsigned);
+   }
+
    return true;
 }
 
 bool JitManager::jit_bc(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels)
 {
-   return bcGeneric<BcCheckCtr | BcCheckCond>(a, instr, cia, jumpLabels, mFinaleFn);
+   return bcGeneric<BcCheckCtr | BcCheckCond>(a, instr, cia, jumpLabels, mFinaleFn, mDispatchFn, &mGeneration);
 }
 
 bool JitManager::jit_bcctr(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels)
 {
-   return bcGeneric<BcBranchCTR | BcCheckCond>(a, instr, cia, jumpLabels, mFinaleFn);
+   return bcGeneric<BcBranchCTR | BcCheckCond>(a, instr, cia, jumpLabels, mFinaleFn, mDispatchFn, &mGeneration);
 }
 
 bool JitManager::jit_bclr(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels)
 {
-   return bcGeneric<BcBranchLR | BcCheckCtr | BcCheckCond>(a, instr, cia, jumpLabels, mFinaleFn);
+   return bcGeneric<BcBranchLR | BcCheckCtr | BcCheckCond>(a, instr, cia, jumpLabels, mFinaleFn, mDispatchFn, &mGeneration);
 }
 
 JitManager::JitManager()
-   : mRuntime(new asmjit::JitRuntime()) {
+   : mRuntime(new asmjit::JitRuntime()), mFloatMode(JitFloatMode::Exact) {
 }
 
 JitManager::~JitManager() {
+   shutdown();
+
    if (mRuntime) {
       delete mRuntime;
       mRuntime = nullptr;
    }
 }
 
+// Guest address of the instruction at addr in the code starting at base
+static uint32_t
+getRangeGuestAddress(uintptr_t base, const JitCodeRange &range, uintptr_t addr)
+{
+   auto &pcMap = range.pcMap;
+   auto offset = static_cast<uint32_t>(addr - base);
+   auto pc = std::upper_bound(pcMap.begin(), pcMap.end(), std::make_pair(offset, 0xFFFFFFFFu));
+
+   if (pc == pcMap.begin()) {
+      return 0;
+   }
+
+   return std::prev(pc)->second;
+}
+
+// Guest address of the instruction a host address in JIT code was
+//   generated for, or 0 if it is not in JIT code.
+uint32_t JitManager::getGuestAddress(const void *host) {
+   std::lock_guard<std::mutex> lock(mPageMutex);
+   auto addr = reinterpret_cast<uintptr_t>(host);
+   auto range = mCodeRanges.upper_bound(addr);
+
+   if (range == mCodeRanges.begin()) {
+      return 0;
+   }
+
+   --range;
+
+   if (addr >= range->second.end) {
+      return 0;
+   }
+
+   return getRangeGuestAddress(range->first, range->second, addr);
+}
+
+// Overwrite the 5 byte nop at from with a jmp to.  fastmemAccess places
+//   the nop within one aligned 8 byte word, so a single store replaces it
+//   and other cores execute either the nop or the jmp.
+static void
+patchJump(uintptr_t from, uintptr_t to)
+{
+   auto shift = (from & 7) * 8;
+   assert((from & 7) <= 3);
+
+   auto word = reinterpret_cast<std::atomic<uint64_t> *>(from & ~static_cast<uintptr_t>(7));
+   auto rel = static_cast<uint32_t>(static_cast<int32_t>(to - (from + 5)));
+   auto jmp = 0xE9ull | (static_cast<uint64_t>(rel) << 8);
+   auto mask = 0xFFFFFFFFFFull << shift;
+   auto value = word->load(std::memory_order_relaxed);
+   word->store((value & ~mask) | (jmp << shift), std::memory_order_release);
+}
+
+// A fastmem access hit an unmapped or guard page, continue in its slow
+//   path.  Sites which keep faulting get patched to always take it.
+bool JitManager::handleAccessFault(uintptr_t &hostPc, ppcaddr_t address, bool write) {
+   std::lock_guard<std::mutex> lock(mPageMutex);
+   auto range = mCodeRanges.upper_bound(hostPc);
+
+   if (range == mCodeRanges.begin()) {
+      return false;
+   }
+
+   --range;
+
+   if (hostPc >= range->second.end) {
+      return false;
+   }
+
+   auto base = range->first;
+   auto offset = static_cast<uint32_t>(hostPc - base);
+
+   for (auto &site : range->second.fastmem) {
+      if (site.access != offset) {
+         continue;
+      }
+
+      gLog->debug("Fastmem {} fault at {:08x} accessing {:08x}",
+                  write ? "write" : "read", getRangeGuestAddress(base, range->second, hostPc), address);
+
+      if (++site.faults == JIT_FASTMEM_PATCH_THRESHOLD) {
+         patchJump(base + site.start, base + site.slowPath);
+      }
+
+      hostPc = base + site.slowPath;
+      return true;
+   }
+
+   return false;
+}
+
+// Frees all generated code, no core may be running JIT code while this
+//   is called.
 void JitManager::clearCache() {
+   std::lock_guard<std::recursive_mutex> lock(mMutex);
+   std::lock_guard<std::mutex> pageLock(mPageMutex);
+
    if (mRuntime) {
       delete mRuntime;
       mRuntime = nullptr;
    }
    
    mRuntime = new asmjit::JitRuntime();
+   mGeneration++;
    mBlocks.clear();
    mSingleBlocks.clear();
+   mVerifyBlocks.clear();
+   mLinks.clear();
+
+   for (auto& page : mCodePages) {
+      gMemory.unprotect(page.first * Memory::HostPageSize, Memory::HostPageSize);
+   }
+
+   mCodePages.clear();
+   gInterpreter.clearDecodeCache();
+   mCodeRanges.clear();
+   mPageCode.clear();
+   mRetired.clear();
+   mRetiredBytes = 0;
+   mInlineCaches.clear();
+   mCounters.clear();
    initStubs();
 }
 
-bool JitManager::prepare(uint32_t addr) {
-   return get(addr) != nullptr;
+// Only affects blocks compiled afterwards, existing blocks keep the mode
+//   they were generated with until clearCache.
+void JitManager::setFloatMode(JitFloatMode mode) {
+   mFloatMode = mode;
+}
+
+void JitManager::setProfileMode(JitProfileMode mode) {
+   mProfileMode = mode;
+}
+
+std::vector<JitProfileEntry> JitManager::getProfile() {
+   std::vector<JitProfileEntry> result;
+
+   {
+      std::lock_guard<std::recursive_mutex> lock(mMutex);
+      for (auto &entry : mProfile) {
+         result.push_back(*entry.second);
+      }
+   }
+
+   std::sort(result.begin(), result.end(), [](const JitProfileEntry &lhs, const JitProfileEntry &rhs) {
+      if (lhs.cycles != rhs.cycles) {
+         return lhs.cycles > rhs.cycles;
+      }
+
+      return lhs.count > rhs.count;
+   });
+
+   return result;
 }
 
-JitCode JitManager::get(uint32_t addr) {
-   auto i = mBlocks.find(addr);
-   if (i != mBlocks.end()) {
-      return i->second;
+std::vector<JitInlineCacheStats> JitManager::getInlineCacheStats() {
+   std::vector<JitInlineCacheStats> result;
+
+   {
+      std::lock_guard<std::recursive_mutex> lock(mMutex);
+      for (auto cache : mInlineCaches) {
+         result.push_back({ cache->cia, cache->used, cache->hits, cache->misses });
+      }
+   }
+
+   std::sort(result.begin(), result.end(), [](const JitInlineCacheStats &lhs, const JitInlineCacheStats &rhs) {
+      return lhs.hits + lhs.misses > rhs.hits + rhs.misses;
+   });
+
+   return result;
+}
+
+bool JitManager::prepare(uint32_t addr) {
+   return get(addr) != nullptr;
+}
+
+// GQRs of the thread running on this core, if any
+static const gqr_t *
+getCurrentGqrs()
+{
+   auto fiber = gProcessor.getCurrentFiber();
+   return fiber ? fiber->state.gqr : nullptr;
+}
+
+// Compiles addr on the calling thread if it has not been compiled yet
+JitCode JitManager::get(uint32_t addr) {
+   if (mBlocks.contains(addr)) {
+      return mBlocks.get(addr);
+   }
+
+   return compile(addr, getCurrentGqrs());
+}
+
+// Returns the compiled code for addr without ever compiling on the
+//   calling thread.  Misses are counted and addr is handed to the
+//   background compiler once it has run JIT_HOT_THRESHOLD times.
+JitCode JitManager::lookup(uint32_t addr) {
+   if (mBlocks.contains(addr)) {
+      return mBlocks.get(addr);
+   }
+
+   if (mCounters.increment(addr) == JIT_HOT_THRESHOLD) {
+      queueCompile(addr);
+   }
+
+   return nullptr;
+}
+
+void JitManager::queueCompile(uint32_t addr) {
+   CompileRequest request;
+   request.addr = addr;
+   request.gqrKnown = false;
+
+   if (auto gqr = getCurrentGqrs()) {
+      request.gqrKnown = true;
+      std::copy(gqr, gqr + 8, request.gqr);
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mQueueMutex);
+      mQueue.push_back(request);
+   }
+
+   mQueueCond.notify_one();
+}
+
+void JitManager::compileThreadEntry() {
+   while (true) {
+      CompileRequest request;
+
+      {
+         std::unique_lock<std::mutex> lock(mQueueMutex);
+         mQueueCond.wait(lock, [this] { return mStopCompileThread || !mQueue.empty(); });
+
+         if (mStopCompileThread) {
+            break;
+         }
+
+         request = mQueue.front();
+         mQueue.pop_front();
+      }
+
+      compile(request.addr, request.gqrKnown ? request.gqr : nullptr);
+   }
+}
+
+JitCode JitManager::compile(uint32_t addr, const gqr_t *gqr) {
+   // Another core may have compiled it while we waited for the lock
+   std::lock_guard<std::recursive_mutex> lock(mMutex);
+   if (mBlocks.contains(addr)) {
+      return mBlocks.get(addr);
+   }
+
+   reclaimCode();
+
+   // Mark it as failed first so we don't
+   //   try to regenerate after a failed attempt.
+   mBlocks.setFailed(addr);
+
+   JitBlock block(addr);
+   block.isolated = !mBlockLinking;
+
+   if (gqr) {
+      block.gqrKnown = true;
+      std::copy(gqr, gqr + 8, block.gqr);
+   }
+
+   gLog->debug("Attempting to JIT {:08x}", block.start);
+
+   // Invalidations no longer wait for us, so check nothing we read
+   //   changed while generating before publishing the block.
+   auto generation = mGeneration.load();
+
+   if (!identBlock(block)) {
+      return nullptr;
+   }
+
+   gLog->debug("Found end at {:08x}", block.end);
+
+   if (!gen(block)) {
+      return nullptr;
+   }
+
+   std::lock_guard<std::mutex> pageLock(mPageMutex);
+   if (mGeneration.load() != generation) {
+      mBlocks.erase(addr);
+      retireCode(block.code);
+      return nullptr;
+   }
+
+   mBlocks.set(block.start, block.entry);
+   for (auto i = block.targets.cbegin(); i != block.targets.cend(); ++i) {
+      if (i->second) {
+         mBlocks.set(i->first, i->second);
+      }
+   }
+
+   if (!block.isolated) {
+      linkBlock(block);
+   }
+
+   protectBlock(block);
+
+   // The block may start at the function entry rather than addr
+   return mBlocks.get(addr);
+}
+
+// Link slots are read by other cores while running JIT code
+static void
+publishLink(JitCode *slot, JitCode code)
+{
+   reinterpret_cast<std::atomic<JitCode> *>(slot)->store(code, std::memory_order_release);
+}
+
+// Patch the exits of a newly compiled block to any already compiled
+//   targets, and the exits of other blocks which target this one,
+//   mPageMutex must be held.
+void JitManager::linkBlock(JitBlock& block) {
+   for (auto& link : block.links) {
+      mLinks[link.target].push_back(link.slot);
+
+      if (auto code = mBlocks.get(link.target)) {
+         publishLink(link.slot, code);
+      }
+   }
+
+   auto patch = [this](uint32_t addr, JitCode code) {
+      auto i = mLinks.find(addr);
+      if (i != mLinks.end()) {
+         for (auto slot : i->second) {
+            publishLink(slot, code);
+         }
+      }
+   };
+
+   patch(block.start, block.entry);
+   for (auto i = block.targets.cbegin(); i != block.targets.cend(); ++i) {
+      if (i->second) {
+         patch(i->first, i->second);
+      }
+   }
+}
+
+// Point every exit linked to addr back at the finale, mPageMutex must be
+//   held.
+void JitManager::unlink(uint32_t addr) {
+   auto i = mLinks.find(addr);
+   if (i != mLinks.end()) {
+      for (auto slot : i->second) {
+         publishLink(slot, mFinaleFn);
+      }
+   }
+}
+
+// Add target to the cache if it has been compiled
+void JitManager::fillInlineCache(JitInlineCache *cache, uint32_t target) {
+   std::lock_guard<std::mutex> lock(mPageMutex);
+   if (cache->used >= JIT_INLINE_CACHE_SIZE) {
+      return;
+   }
+
+   for (auto i = 0u; i < cache->used; ++i) {
+      if (cache->targets[i] == target) {
+         return;
+      }
+   }
+
+   auto code = mBlocks.get(target);
+   if (!code) {
+      return;
+   }
+
+   // The host slot has to be visible before the target matches
+   auto slot = &cache->hosts[cache->used];
+   mLinks[target].push_back(slot);
+   publishLink(slot, code);
+   reinterpret_cast<std::atomic<uint32_t> *>(&cache->targets[cache->used])->store(target, std::memory_order_release);
+   cache->used++;
+}
+
+// Drop the compiled entry for addr so it is regenerated on next use,
+//   the old code is left in place until its page is invalidated.
+void JitManager::invalidate(uint32_t addr) {
+   std::lock_guard<std::mutex> lock(mPageMutex);
+   mGeneration++;
+   eraseBlock(addr);
+}
+
+// Make addr unreachable from the block table and every linked exit,
+//   mPageMutex must be held.
+void JitManager::eraseBlock(uint32_t addr) {
+   mBlocks.erase(addr);
+   mSingleBlocks.erase(addr);
+   mVerifyBlocks.erase(addr);
+   mCounters.reset(addr);
+   unlink(addr);
+}
+
+// Record which code pages the block was generated from and write protect
+//   them so any later modification invalidates the block, mPageMutex must
+//   be held.
+void JitManager::protectBlock(const JitBlock& block) {
+   auto first = block.start / Memory::HostPageSize;
+   auto last = (block.end - 1) / Memory::HostPageSize;
+
+   for (auto page = first; page <= last; ++page) {
+      auto i = mCodePages.find(page);
+      if (i == mCodePages.end()) {
+         i = mCodePages.emplace(page, std::set<uint32_t>()).first;
+         gMemory.protect(page * Memory::HostPageSize, Memory::HostPageSize);
+      }
+
+      mPageCode[page].insert(block.code);
+
+      i->second.insert(block.start);
+      for (auto j = block.targets.cbegin(); j != block.targets.cend(); ++j) {
+         if (j->second) {
+            i->second.insert(j->first);
+         }
+      }
+   }
+}
+
+void JitManager::protectCodePage(uint32_t page, std::atomic<bool> *decoded) {
+   std::lock_guard<std::mutex> lock(mPageMutex);
+
+   if (mCodePages.find(page) == mCodePages.end()) {
+      mCodePages.emplace(page, std::set<uint32_t>());
+      gMemory.protect(page * Memory::HostPageSize, Memory::HostPageSize);
+   }
+
+   decoded->store(true);
+}
+
+// Drop every block generated from the page and make it writable again,
+//   mPageMutex must be held.
+bool JitManager::invalidatePage(uint32_t page) {
+   auto i = mCodePages.find(page);
+   if (i == mCodePages.end()) {
+      return false;
+   }
+
+   mGeneration++;
+
+   for (auto addr : i->second) {
+      eraseBlock(addr);
+   }
+
+   // Also forget failed attempts so modified code gets another try
+   auto start = page * Memory::HostPageSize;
+   for (auto addr = start; addr < start + Memory::HostPageSize; addr += 4) {
+      eraseBlock(addr);
+   }
+
+   // Nothing can reach the code any more, free it once nobody runs it
+   auto code = mPageCode.find(page);
+   if (code != mPageCode.end()) {
+      auto bases = code->second;
+      for (auto base : bases) {
+         retireCode(base);
+      }
+   }
+
+   gInterpreter.invalidatePage(page);
+   mCodePages.erase(i);
+   gMemory.unprotect(start, Memory::HostPageSize);
+   return true;
+}
+
+// Invalidate all code generated from [addr, addr + size), returns whether
+//   any compiled code was affected.  Called from the write fault handler,
+//   so it must not wait for the compiler.
+bool JitManager::invalidateRange(uint32_t addr, uint32_t size) {
+   if (size == 0) {
+      return false;
+   }
+
+   std::lock_guard<std::mutex> lock(mPageMutex);
+   auto first = addr / Memory::HostPageSize;
+   auto last = (addr + size - 1) / Memory::HostPageSize;
+   auto result = false;
+
+   for (auto page = first; page <= last; ++page) {
+      result |= invalidatePage(page);
+   }
+
+   return result;
+}
+
+static std::atomic<uint32_t> &
+getJitEpoch(ThreadState *state)
+{
+   return *reinterpret_cast<std::atomic<uint32_t> *>(&state->jitEpoch);
+}
+
+// Warn each time this much unreachable code is still waiting to be freed
+static const uint64_t JIT_RETIRED_WARN_BYTES = 16 * 1024 * 1024;
+
+// Queue generated code which is no longer reachable through mBlocks or any
+//   link to be freed by reclaimCode, mPageMutex must be held.
+void JitManager::retireCode(uintptr_t base) {
+   auto i = mCodeRanges.find(base);
+   if (i == mCodeRanges.end() || i->second.retired) {
+      return;
+   }
+
+   auto &range = i->second;
+   range.retired = true;
+
+   for (auto page = range.firstPage; page <= range.lastPage; ++page) {
+      auto code = mPageCode.find(page);
+      if (code != mPageCode.end()) {
+         code->second.erase(base);
+         if (code->second.empty()) {
+            mPageCode.erase(code);
+         }
+      }
+   }
+
+   // Threads which enter JIT code from now on can not reach it
+   mRetired.push_back({ base, mRetireEpoch.fetch_add(1) });
+
+   auto before = mRetiredBytes;
+   mRetiredBytes += range.end - base;
+
+   if (mRetiredBytes / JIT_RETIRED_WARN_BYTES > before / JIT_RETIRED_WARN_BYTES) {
+      gLog->warn("{} MB of invalidated JIT code is waiting for threads to leave it", mRetiredBytes / (1024 * 1024));
+   }
+}
+
+// Free retired code which no thread can still be running, mMutex must be
+//   held so nothing is generated in between.  A thread stays in the epoch
+//   it entered JIT code in until it is back in the interpreter loop.
+void JitManager::reclaimCode() {
+   {
+      std::lock_guard<std::mutex> lock(mPageMutex);
+      if (mRetired.empty()) {
+         return;
+      }
+   }
+
+   auto oldest = mRetireEpoch.load();
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+
+   gProcessor.forEachFiber([&](Fiber *fiber) {
+      auto epoch = getJitEpoch(&fiber->state).load();
+      if (epoch && epoch < oldest) {
+         oldest = epoch;
+      }
+   });
+
+   std::lock_guard<std::mutex> lock(mPageMutex);
+   std::map<uintptr_t, uintptr_t> freed;
+   auto kept = mRetired.begin();
+
+   for (auto &code : mRetired) {
+      if (code.epoch < oldest) {
+         freed.emplace(code.base, mCodeRanges[code.base].end);
+      } else {
+         *kept++ = code;
+      }
+   }
+
+   mRetired.erase(kept, mRetired.end());
+
+   if (freed.empty()) {
+      return;
+   }
+
+   auto isFreed = [&freed](const void *ptr) {
+      auto addr = reinterpret_cast<uintptr_t>(ptr);
+      auto range = freed.upper_bound(addr);
+      return range != freed.begin() && addr < std::prev(range)->second;
+   };
+
+   // Nothing may patch or read the code once it is released
+   for (auto i = mLinks.begin(); i != mLinks.end(); ) {
+      auto &slots = i->second;
+      slots.erase(std::remove_if(slots.begin(), slots.end(), isFreed), slots.end());
+
+      if (slots.empty()) {
+         i = mLinks.erase(i);
+      } else {
+         ++i;
+      }
+   }
+
+   mInlineCaches.erase(std::remove_if(mInlineCaches.begin(), mInlineCaches.end(), isFreed), mInlineCaches.end());
+
+   for (auto &code : freed) {
+      mRetiredBytes -= code.second - code.first;
+      mCodeRanges.erase(code.first);
+      mRuntime->release(reinterpret_cast<void *>(code.first));
+   }
+}
+
+struct JitCacheHeader
+{
+   static const uint32_t Magic = 0x4A495443; // JITC
+
+   uint32_t magic;
+   uint32_t version;
+   uint32_t hash;
+   uint32_t numBlocks;
+};
+
+// Directory block caches are stored in, caching is disabled while empty
+void JitManager::setCachePath(const std::string &path) {
+   mCachePath = path;
+}
+
+static std::string
+getCacheFilename(const std::string &path, const std::string &name)
+{
+   return path + "/" + name + ".jitcache";
+}
+
+// Marks every block recorded for this code section by a previous run as
+//   hot, so the first core to run one queues it for the background compiler
+//   with its own GQRs.  The cache is ignored if the code has changed since.
+void JitManager::loadCache(const std::string &name, uint32_t start, uint32_t end) {
+   if (mCachePath.empty() || end <= start) {
+      return;
+   }
+
+   auto hash = crc32(gMemory.translate(start), end - start);
+   mCachedModules.emplace_back(CachedModule { name, start, end, hash });
+
+   auto file = std::ifstream { getCacheFilename(mCachePath, name), std::ifstream::binary };
+   if (!file.is_open()) {
+      return;
+   }
+
+   JitCacheHeader header;
+   file.read(reinterpret_cast<char *>(&header), sizeof(JitCacheHeader));
+
+   if (!file || header.magic != JitCacheHeader::Magic || header.version != JIT_CACHE_VERSION || header.hash != hash) {
+      gLog->debug("Ignoring stale JIT cache for {}", name);
+      return;
+   }
+
+   auto offsets = std::vector<uint32_t>(header.numBlocks);
+   file.read(reinterpret_cast<char *>(offsets.data()), offsets.size() * sizeof(uint32_t));
+
+   if (!file) {
+      gLog->warn("Truncated JIT cache for {}", name);
+      return;
+   }
+
+   auto seeded = 0u;
+   for (auto offset : offsets) {
+      if (offset < end - start) {
+         mCounters.seed(start + offset, JIT_HOT_THRESHOLD - 1);
+         seeded++;
+      }
+   }
+
+   gLog->info("Marked {} of {} cached blocks hot for {}", seeded, offsets.size(), name);
+}
+
+// Writes the entry points of every block currently compiled in the
+//   sections passed to loadCache.
+void JitManager::saveCache() {
+   if (mCachePath.empty()) {
+      return;
+   }
+
+   std::lock_guard<std::recursive_mutex> lock(mMutex);
+   std::lock_guard<std::mutex> pageLock(mPageMutex);
+
+   for (auto &module : mCachedModules) {
+      std::set<uint32_t> blocks;
+      auto first = module.start / Memory::HostPageSize;
+      auto last = (module.end - 1) / Memory::HostPageSize;
+
+      for (auto i = mCodePages.lower_bound(first); i != mCodePages.end() && i->first <= last; ++i) {
+         for (auto addr : i->second) {
+            if (addr >= module.start && addr < module.end && mBlocks.get(addr)) {
+               blocks.insert(addr - module.start);
+            }
+         }
+      }
+
+      auto file = std::ofstream { getCacheFilename(mCachePath, module.name), std::ofstream::binary | std::ofstream::trunc };
+      if (!file.is_open()) {
+         gLog->warn("Could not write JIT cache for {}", module.name);
+         continue;
+      }
+
+      JitCacheHeader header;
+      header.magic = JitCacheHeader::Magic;
+      header.version = JIT_CACHE_VERSION;
+      header.hash = module.hash;
+      header.numBlocks = static_cast<uint32_t>(blocks.size());
+      file.write(reinterpret_cast<const char *>(&header), sizeof(JitCacheHeader));
+
+      for (auto offset : blocks) {
+         file.write(reinterpret_cast<const char *>(&offset), sizeof(uint32_t));
+      }
+   }
+}
+
+JitCode JitManager::getSingle(uint32_t addr) {
+   if (mSingleBlocks.contains(addr)) {
+      return mSingleBlocks.get(addr);
+   }
+
+   std::lock_guard<std::recursive_mutex> lock(mMutex);
+   if (mSingleBlocks.contains(addr)) {
+      return mSingleBlocks.get(addr);
+   }
+
+   mSingleBlocks.setFailed(addr);
+   reclaimCode();
+
+   auto generation = mGeneration.load();
+   JitBlock block(addr);
+   block.end = block.start + 4;
+   block.isolated = true;
+
+   if (auto gqr = getCurrentGqrs()) {
+      block.gqrKnown = true;
+      std::copy(gqr, gqr + 8, block.gqr);
+   }
+
+   if (!gen(block)) {
+      return nullptr;
+   }
+
+   std::lock_guard<std::mutex> pageLock(mPageMutex);
+   if (mGeneration.load() != generation) {
+      mSingleBlocks.erase(addr);
+      retireCode(block.code);
+      return nullptr;
+   }
+
+   mSingleBlocks.set(addr, block.entry);
+   protectBlock(block);
+   return block.entry;
+}
+
+// Instructions whose effects can not be repeated by Interpreter::verifyBlock
+static bool
+isVerifiable(InstructionID id)
+{
+   switch (id) {
+   case InstructionID::kc:
+   case InstructionID::sc:
+   case InstructionID::rfi:
+   case InstructionID::mftb:
+      return false;
+   default:
+      return true;
+   }
+}
+
+const JitVerifyBlock *JitManager::getVerify(uint32_t addr) {
+   std::lock_guard<std::recursive_mutex> lock(mMutex);
+
+   {
+      std::lock_guard<std::mutex> pageLock(mPageMutex);
+      auto i = mVerifyBlocks.find(addr);
+      if (i != mVerifyBlocks.end()) {
+         return i->second.get();
+      }
+   }
+
+   // Stays null if the block can not be verified
+   auto generation = mGeneration.load();
+   auto result = genVerify(addr, generation);
+   auto verify = result.get();
+
+   // Guest code changed while generating, try again next time
+   std::lock_guard<std::mutex> pageLock(mPageMutex);
+   if (mGeneration.load() != generation) {
+      return nullptr;
+   }
+
+   mVerifyBlocks[addr] = std::move(result);
+   return verify;
+}
+
+std::unique_ptr<JitVerifyBlock> JitManager::genVerify(uint32_t addr, uint32_t generation) {
+   JitBlock block(addr);
+   block.isolated = true;
+
+   if (auto gqr = getCurrentGqrs()) {
+      block.gqrKnown = true;
+      std::copy(gqr, gqr + 8, block.gqr);
+   }
+
+   if (!identBlock(block)) {
+      return nullptr;
+   }
+
+   for (auto lclCia = block.start; lclCia < block.end; lclCia += 4) {
+      auto data = gInstructionTable.decode(gMemory.read<Instruction>(lclCia));
+      if (!block.unreachable.count(lclCia) && (!data || !isVerifiable(data->id))) {
+         return nullptr;
+      }
+   }
+
+   if (!gen(block)) {
+      return nullptr;
+   }
+
+   std::lock_guard<std::mutex> pageLock(mPageMutex);
+   auto entry = addr == block.start ? block.entry : block.targets[addr];
+   if (!entry || mGeneration.load() != generation) {
+      retireCode(block.code);
+      return nullptr;
+   }
+
+   protectBlock(block);
+
+   std::unique_ptr<JitVerifyBlock> result { new JitVerifyBlock() };
+   result->start = block.start;
+   result->end = block.end;
+   result->entry = entry;
+
+   for (auto &target : block.targets) {
+      if (target.first >= block.start && target.first < block.end) {
+         result->targets.insert(target.first);
+      }
+   }
+
+   return result;
+}
+
+typedef std::vector<uint32_t> JumpTargetList;
+
+// Registers a function found by the loader, size is 0 when unknown
+void JitManager::addFunction(uint32_t start, uint32_t size) {
+   std::lock_guard<std::recursive_mutex> lock(mMutex);
+   auto &fnSize = mFunctions[start];
+   fnSize = std::max(fnSize, size);
+}
+
+void JitManager::addSymbol(uint32_t addr, const std::string &name) {
+   std::lock_guard<std::recursive_mutex> lock(mMutex);
+   mSymbols.emplace(addr, name);
+}
+
+void JitManager::setPerfMapPath(const std::string &dir) {
+   mPerfMapPath = dir;
+}
+
+void JitManager::setBlockLinking(bool enabled) {
+   mBlockLinking = enabled;
+}
+
+// Nearest symbol for a block, unless another function known to the loader
+//   starts in between.
+std::string JitManager::getBlockName(uint32_t addr) {
+   auto symbol = mSymbols.upper_bound(addr);
+   auto function = mFunctions.upper_bound(addr);
+
+   if (symbol == mSymbols.begin()) {
+      return fmt::format("ppc_{:08x}", addr);
+   }
+
+   --symbol;
+
+   if (function != mFunctions.begin() && std::prev(function)->first > symbol->first) {
+      return fmt::format("ppc_{:08x}", addr);
+   }
+
+   if (symbol->first == addr) {
+      return symbol->second;
+   }
+
+   return fmt::format("{}+0x{:x}", symbol->second, addr - symbol->first);
+}
+
+// Walks the control flow of the loader known function containing
+//   block.start.  The block then covers the whole function, every branch
+//   target inside it becomes an entry point and words which are never
+//   reached are skipped.
+bool JitManager::identFunction(JitBlock& block) {
+   auto addr = block.start;
+   auto next = mFunctions.upper_bound(addr);
+
+   if (next == mFunctions.begin()) {
+      return false;
+   }
+
+   auto fn = std::prev(next);
+   auto fnStart = fn->first;
+   auto fnLimit = fnStart + JIT_MAX_INST * 4;
+
+   if (fn->second) {
+      fnLimit = fnStart + fn->second;
+   }
+
+   if (next != mFunctions.end()) {
+      fnLimit = std::min(fnLimit, next->first);
+   }
+
+   // A function which is already compiled (or failed) did not have addr as
+   //   an entry point, so addr is not reachable from the function entry.
+   if (addr >= fnLimit || (addr != fnStart && mBlocks.contains(fnStart))) {
+      return false;
    }
 
-   // Set it to nullptr first so we don't
-   //   try to regenerate after a failed attempt.
-   mBlocks[addr] = nullptr;
+   std::set<uint32_t> reachable;
+   std::set<uint32_t> targets;
+   std::vector<uint32_t> pending = { fnStart };
 
-   JitBlock block(addr);
+   while (!pending.empty()) {
+      auto lclCia = pending.back();
+      pending.pop_back();
 
-   gLog->debug("Attempting to JIT {:08x}", block.start);
+      while (lclCia >= fnStart && lclCia < fnLimit && reachable.insert(lclCia).second) {
+         auto instr = gMemory.read<Instruction>(lclCia);
+         auto data = gInstructionTable.decode(instr);
 
-   if (!identBlock(block)) {
-      return nullptr;
-   }
+         if (!data) {
+            return false;
+         }
 
-   gLog->debug("Found end at {:08x}", block.end);
+         if (reachable.size() > JIT_MAX_INST) {
+            gLog->debug("Bailing on JIT due to max instruction limit in function {:08x}", fnStart);
+            return false;
+         }
 
-   if (!gen(block)) {
-      return nullptr;
-   }
+         auto isBranch = data->id == InstructionID::b || data->id == InstructionID::bc
+                      || data->id == InstructionID::bcctr || data->id == InstructionID::bclr;
 
-   mBlocks[block.start] = block.entry;
-   for (auto i = block.targets.cbegin(); i != block.targets.cend(); ++i) {
-      if (i->second) {
-         mBlocks[i->first] = i->second;
+         if (!JIT_CONTINUE_ON_ERROR && !isBranch && !sJitInstructionMap[static_cast<size_t>(data->id)]) {
+            gLog->debug("JIT bailing due to unimplemented instruction {}", data->name);
+            return false;
+         }
+
+         auto unconditional = true;
+         uint32_t nia = 0;
+
+         switch (data->id) {
+         case InstructionID::b:
+            nia = sign_extend<26>(instr.li << 2);
+            break;
+         case InstructionID::bc:
+            nia = sign_extend<16>(instr.bd << 2);
+            // Fall through
+         case InstructionID::bcctr:
+         case InstructionID::bclr:
+            unconditional = get_bit<NoCheckCond>(instr.bo) && get_bit<NoCheckCtr>(instr.bo);
+            break;
+         default:
+            break;
+         }
+
+         if (isBranch) {
+            if (data->id == InstructionID::b || data->id == InstructionID::bc) {
+               if (!instr.aa) {
+                  nia += lclCia;
+               }
+
+               // Calls leave the function, anything else inside it is followed
+               if (!instr.lk && nia >= fnStart && nia < fnLimit) {
+                  targets.insert(nia);
+                  pending.push_back(nia);
+               }
+            }
+
+            if (instr.lk) {
+               targets.insert(lclCia + 4);
+            } else if (unconditional) {
+               break;
+            }
+         }
+
+         lclCia += 4;
       }
    }
-   return block.entry;
-}
 
-JitCode JitManager::getSingle(uint32_t addr) {
-   auto i = mSingleBlocks.find(addr);
-   if (i != mSingleBlocks.end()) {
-      return i->second;
+   if (!reachable.count(addr)) {
+      return false;
    }
 
-   mSingleBlocks[addr] = nullptr;
+   block.start = fnStart;
+   block.end = *reachable.rbegin() + 4;
 
-   JitBlock block(addr);
-   block.end = block.start + 4;
+   for (auto lclCia = block.start; lclCia < block.end; lclCia += 4) {
+      if (!reachable.count(lclCia)) {
+         block.unreachable.insert(lclCia);
+      }
+   }
 
-   if (!gen(block)) {
-      return nullptr;
+   if (addr != fnStart) {
+      targets.insert(addr);
    }
 
-   mSingleBlocks[addr] = block.entry;
-   return block.entry;
-}
+   for (auto target : targets) {
+      block.targets[target] = nullptr;
+   }
 
-typedef std::vector<uint32_t> JumpTargetList;
+   return true;
+}
 
 bool JitManager::identBlock(JitBlock& block) {
+   if (identFunction(block)) {
+      return true;
+   }
+
    auto fnStart = block.start;
    auto fnMax = fnStart;
    auto fnEnd = fnStart;
@@ -413,6 +1906,339 @@ bool JitManager::identBlock(JitBlock& block) {
    return true;
 }
 
+static void
+countGprUse(uint32_t uses[32], Field field, Instruction instr)
+{
+   switch (field) {
+   case Field::rA:
+      uses[instr.rA]++;
+      break;
+   case Field::rB:
+      uses[instr.rB]++;
+      break;
+   case Field::rD:
+      uses[instr.rD]++;
+      break;
+   case Field::rS:
+      uses[instr.rS]++;
+      break;
+   default:
+      break;
+   }
+}
+
+// Cache the GPRs which are used most within the block in host registers,
+//   a GPR which is only touched once is not worth the load and flush.
+static void
+allocateGprCache(PPCEmuAssembler& a, const JitBlock& block)
+{
+   uint32_t uses[32] = { 0 };
+
+   for (auto lclCia = block.start; lclCia < block.end; lclCia += 4) {
+      auto instr = gMemory.read<Instruction>(lclCia);
+      auto data = gInstructionTable.decode(instr);
+
+      if (!data) {
+         continue;
+      }
+
+      for (auto field : data->read) {
+         countGprUse(uses, field, instr);
+      }
+
+      for (auto field : data->write) {
+         countGprUse(uses, field, instr);
+      }
+   }
+
+   std::vector<uint32_t> gprs;
+   for (auto i = 0u; i < 32; ++i) {
+      if (uses[i] >= 2) {
+         gprs.push_back(i);
+      }
+   }
+
+   std::stable_sort(gprs.begin(), gprs.end(), [&](uint32_t x, uint32_t y) {
+      return uses[x] > uses[y];
+   });
+
+   if (gprs.size() > JIT_GPR_CACHE_SIZE) {
+      gprs.resize(JIT_GPR_CACHE_SIZE);
+   }
+
+   a.setGprCache(gprs);
+}
+
+// If the instruction after cia is a bc which only tests a lt/gt/eq bit
+//   and is not a jump target itself, returns the CR field it tests so the
+//   instruction at cia can leave its result in the host flags.
+static int
+getFusableCrf(const JitBlock& block, uint32_t cia, const JumpLabelMap& jumpLabels)
+{
+   auto next = cia + 4;
+   if (next >= block.end || jumpLabels.find(next) != jumpLabels.end()) {
+      return -1;
+   }
+
+   auto instr = gMemory.read<Instruction>(next);
+   auto data = gInstructionTable.decode(instr);
+   if (!data || data->id != InstructionID::bc) {
+      return -1;
+   }
+
+   // Decrementing CTR would clobber the host flags
+   if (get_bit<NoCheckCond>(instr.bo) || !get_bit<NoCheckCtr>(instr.bo)) {
+      return -1;
+   }
+
+   // Summary overflow is not in the host flags
+   if ((instr.bi % 4) == 3) {
+      return -1;
+   }
+
+   return instr.bi / 4;
+}
+
+// Whether CR field crf is completely overwritten before anything could
+//   read it when execution continues at addr.  Only follows straight line
+//   code, any branch or unknown CR access counts as a read.
+static bool
+isCrfDead(const JitBlock& block, uint32_t addr, uint32_t crf)
+{
+   for (auto lclCia = addr; lclCia < block.end; lclCia += 4) {
+      auto instr = gMemory.read<Instruction>(lclCia);
+      auto data = gInstructionTable.decode(instr);
+
+      if (!data) {
+         return false;
+      }
+
+      switch (data->id) {
+      case InstructionID::cmp:
+      case InstructionID::cmpi:
+      case InstructionID::cmpl:
+      case InstructionID::cmpli:
+         if (instr.crfD == crf) {
+            return true;
+         }
+         continue;
+      case InstructionID::addicx:
+      case InstructionID::andi:
+      case InstructionID::andis:
+         if (crf == 0) {
+            return true;
+         }
+         continue;
+      case InstructionID::b:
+      case InstructionID::bc:
+      case InstructionID::bcctr:
+      case InstructionID::bclr:
+      case InstructionID::kc:
+      case InstructionID::mfcr:
+      case InstructionID::stwcx:
+         return false;
+      default:
+         break;
+      }
+
+      // Float and paired single record forms write cr1, including the
+      //   FPSCR moves like mtfsf which have no frD
+      auto isFloat = instr.opcd == 59 || instr.opcd == 63 || instr.opcd == 4;
+      auto fields = data->read;
+      fields.insert(fields.end(), data->write.begin(), data->write.end());
+      fields.insert(fields.end(), data->flags.begin(), data->flags.end());
+
+      for (auto field : fields) {
+         switch (field) {
+         case Field::bi:
+         case Field::crbA:
+         case Field::crbB:
+         case Field::crbD:
+         case Field::crfD:
+         case Field::crfS:
+         case Field::crm:
+         case Field::CR:
+            return false;
+         case Field::rc:
+            // Record forms overwrite all of cr0, or cr1 for floats
+            if (instr.rc && crf == (isFloat ? 1u : 0u)) {
+               return true;
+            }
+            break;
+         default:
+            break;
+         }
+      }
+   }
+
+   return false;
+}
+
+// Whether XER[CA] is overwritten before anything could read it when
+//   execution continues at addr, like isCrfDead.
+static bool
+isCarryDead(const JitBlock& block, uint32_t addr)
+{
+   for (auto lclCia = addr; lclCia < block.end; lclCia += 4) {
+      auto instr = gMemory.read<Instruction>(lclCia);
+      auto data = gInstructionTable.decode(instr);
+
+      if (!data) {
+         return false;
+      }
+
+      switch (data->id) {
+      case InstructionID::adde:
+      case InstructionID::addme:
+      case InstructionID::addze:
+      case InstructionID::subfe:
+      case InstructionID::subfme:
+      case InstructionID::subfze:
+      case InstructionID::mcrxr:
+      case InstructionID::mfspr:
+      case InstructionID::mtspr:
+      case InstructionID::b:
+      case InstructionID::bc:
+      case InstructionID::bcctr:
+      case InstructionID::bclr:
+      case InstructionID::kc:
+         return false;
+      default:
+         break;
+      }
+
+      // Everything else which writes XER sets CA without reading it
+      if (std::find(data->write.begin(), data->write.end(), Field::XER) != data->write.end()) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+// Track GPRs with values known at compile time across instr, anything
+//   written which is not a simple constant becomes unknown.
+static void
+propagateConstants(PPCEmuAssembler& a, Instruction instr, const InstructionData *data)
+{
+   switch (data->id) {
+   case InstructionID::addi:
+   case InstructionID::addis:
+      if (instr.rA == 0 || a.isGprKnown(instr.rA)) {
+         auto value = instr.rA == 0 ? 0u : a.knownGprValues[instr.rA];
+         auto imm = sign_extend<16, uint32_t>(instr.simm);
+         value += (data->id == InstructionID::addis) ? (imm << 16) : imm;
+         a.setGprKnown(instr.rD, value);
+         return;
+      }
+      break;
+   case InstructionID::ori:
+   case InstructionID::oris:
+      if (a.isGprKnown(instr.rS)) {
+         auto imm = static_cast<uint32_t>(instr.uimm);
+         imm = (data->id == InstructionID::oris) ? (imm << 16) : imm;
+         a.setGprKnown(instr.rA, a.knownGprValues[instr.rS] | imm);
+         return;
+      }
+      break;
+   case InstructionID::lmw:
+      for (auto r = instr.rD; r < 32; ++r) {
+         a.knownGprs &= ~(1u << r);
+      }
+      return;
+   case InstructionID::lswi:
+   case InstructionID::lswx:
+   case InstructionID::kc:
+   case InstructionID::sc:
+   case InstructionID::rfi:
+   case InstructionID::b:
+   case InstructionID::bcctr:
+   case InstructionID::bclr:
+      a.knownGprs = 0;
+      return;
+   case InstructionID::bc:
+      if (instr.lk) {
+         a.knownGprs = 0;
+      }
+      return;
+   default:
+      break;
+   }
+
+   for (auto field : data->write) {
+      if (field == Field::rD) {
+         a.knownGprs &= ~(1u << instr.rD);
+      } else if (field == Field::rA) {
+         a.knownGprs &= ~(1u << instr.rA);
+      }
+   }
+}
+
+// Whether anything in the block reads FPSCR, paired single code in fast
+//   blocks does not keep it up to date.
+static bool
+readsFPSCR(const JitBlock& block)
+{
+   for (auto lclCia = block.start; lclCia < block.end; lclCia += 4) {
+      auto instr = gMemory.read<Instruction>(lclCia);
+      auto data = gInstructionTable.decode(instr);
+
+      if (!data) {
+         continue;
+      }
+
+      if (data->id == InstructionID::mffs || data->id == InstructionID::mcrfs) {
+         return true;
+      }
+
+      // Record forms copy the FPSCR exception summary into cr1
+      auto writesFPSCR = std::find(data->write.begin(), data->write.end(), Field::FPSCR) != data->write.end();
+      if (writesFPSCR && instr.rc) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+// Whether the FPSCR update native scalar float code left pending has to be
+//   written before this instruction, see JitFloatMode.
+static bool
+observesFloatStatus(const PPCEmuAssembler& a, Instruction instr, const InstructionData *data)
+{
+   // The scalar float emitters deal with it themselves
+   if (!a.fpscrPending || isNativeFloat(data->id)) {
+      return false;
+   }
+
+   switch (data->id) {
+   case InstructionID::b:
+   case InstructionID::bc:
+   case InstructionID::bcctr:
+   case InstructionID::bclr:
+   case InstructionID::kc:
+      return true;
+   default:
+      break;
+   }
+
+   auto fptr = sJitInstructionMap[static_cast<size_t>(data->id)];
+   if (!fptr || fptr == &jit_fallback) {
+      return true;
+   }
+
+   // Paired single code in fast blocks does not touch FPSCR
+   auto reads = std::find(data->read.begin(), data->read.end(), Field::FPSCR) != data->read.end();
+   auto writes = std::find(data->write.begin(), data->write.end(), Field::FPSCR) != data->write.end();
+   if ((reads || writes) && !(a.fastFloat && instr.opcd == 4 && !instr.rc)) {
+      return true;
+   }
+
+   // Overwrites the register FPRF still has to be set from
+   auto writesFrD = std::find(data->write.begin(), data->write.end(), Field::frD) != data->write.end();
+   return writesFrD && static_cast<int>(instr.frD) == a.fprfPending;
+}
+
 bool JitManager::gen(JitBlock& block)
 {
    PPCEmuAssembler a(mRuntime);
@@ -422,29 +2248,105 @@ bool JitManager::gen(JitBlock& block)
    for (auto i = block.targets.begin(); i != block.targets.end(); ++i) {
       if (i->first >= block.start && i->first < block.end) {
          jumpLabels[i->first] = asmjit::Label(a);
+         a.entryLabels[i->first] = asmjit::Label(a);
       }
    }
 
+#ifdef _DEBUG
    // Fix VS debug viewer...
    for (int i = 0; i < 8; ++i) {
       a.nop();
    }
+#endif
+
+   allocateGprCache(a, block);
+   a.fastFloat = mFloatMode == JitFloatMode::Fast && !readsFPSCR(block);
+   a.floatMode = mFloatMode;
+   a.cpuFeatures = mCpuFeatures;
+   a.profiling = mProfileMode != JitProfileMode::Disabled;
+   a.isolated = block.isolated;
+
+   if (block.gqrKnown) {
+      a.gqrKnown = true;
+      std::copy(block.gqr, block.gqr + 8, a.gqr);
+   }
+
+   JitProfileEntry *profile = nullptr;
+   if (mProfileMode != JitProfileMode::Disabled) {
+      auto &entry = mProfile[block.start];
+      if (!entry) {
+         entry.reset(new JitProfileEntry());
+         entry->start = block.start;
+      }
+
+      profile = entry.get();
+   }
 
    asmjit::Label codeStart(a);
    a.bind(codeStart);
 
+   if (profile) {
+      genProfileEntry(a, profile, mProfileMode);
+   }
+
+   a.reloadGprCache();
+
    auto lclCia = block.start;
    while (lclCia < block.end) {
+      if (block.unreachable.count(lclCia)) {
+         lclCia += 4;
+         continue;
+      }
+
       auto ciaLbl = jumpLabels.find(lclCia);
       if (ciaLbl != jumpLabels.end()) {
+         flushFloatStatus(a);
          a.bind(ciaLbl->second);
+
+         // Other paths join here
+         a.knownGprs = 0;
       }
 
-      a.mov(a.cia, lclCia);
+      a.genCia = lclCia;
+      block.pcMap.push_back({ static_cast<uint32_t>(a.getOffset()), lclCia });
 
       auto instr = gMemory.read<Instruction>(lclCia);
       auto data = gInstructionTable.decode(instr);
 
+      // Lazy CR, only a bc can consume the host flags of the previous
+      //   instruction, and it only has to write the CR field on the paths
+      //   where something may still read it.
+      if (data->id != InstructionID::bc) {
+         a.pendingCrField = -1;
+      } else if (a.pendingCrField >= 0) {
+         auto crf = static_cast<uint32_t>(a.pendingCrField);
+         auto nia = lclCia + sign_extend<16>(instr.bd << 2);
+         a.crLiveTaken = jumpLabels.find(nia) == jumpLabels.end() || !isCrfDead(block, nia, crf);
+         a.crLiveFallthrough = !isCrfDead(block, lclCia + 4, crf);
+      }
+
+      a.crFuseField = getFusableCrf(block, lclCia, jumpLabels);
+
+      // Also before an instruction leaving its result in the host flags
+      //   for the next bc, the flush would clobber them.
+      if (a.crFuseField >= 0 || observesFloatStatus(a, instr, data)) {
+         flushFloatStatus(a);
+      }
+
+      a.idleLoop = false;
+      if (data->id == InstructionID::bc && !instr.aa) {
+         auto nia = lclCia + sign_extend<16>(instr.bd << 2);
+         a.idleLoop = nia < lclCia && isIdleLoop(nia, lclCia);
+      }
+
+      // Flag writes which nothing reads, only scan for instructions which
+      //   can write them.
+      auto hasRecord = std::find(data->flags.begin(), data->flags.end(), Field::rc) != data->flags.end();
+      auto alwaysRecord = data->id == InstructionID::addicx || data->id == InstructionID::andi || data->id == InstructionID::andis;
+      auto writesXer = std::find(data->write.begin(), data->write.end(), Field::XER) != data->write.end();
+      a.cr0Dead = ((hasRecord && instr.rc) || alwaysRecord) && isCrfDead(block, lclCia + 4, 0);
+      a.carryDead = writesXer && isCarryDead(block, lclCia + 4);
+
       bool genSuccess = false;
       if (data->id == InstructionID::b) {
          genSuccess = jit_b(a, instr, lclCia, jumpLabels);
@@ -472,7 +2374,15 @@ bool JitManager::gen(JitBlock& block)
          }
       }
 
+      if (data->id == InstructionID::bc) {
+         a.pendingCrField = -1;
+      }
+
+      propagateConstants(a, instr, data);
+
+#ifdef _DEBUG
       a.nop();
+#endif
 
       lclCia += 4;
    }
@@ -488,20 +2398,93 @@ bool JitManager::gen(JitBlock& block)
       }
    }
 
-   a.mov(a.eax, block.end);
-   a.jmp(asmjit::Ptr(mFinaleFn));
+   flushFloatStatus(a);
+   jumpToGuest(a, block.end, mFinaleFn);
+
+   // Entry points for jumping into the middle of the block from
+   //   outside, these have to load the GPR cache first.
+   for (auto i = jumpLabels.begin(); i != jumpLabels.end(); ++i) {
+      auto entryLbl = a.entryLabels[i->first];
+      a.bind(entryLbl);
+
+      if (profile) {
+         genProfileEntry(a, profile, mProfileMode);
+      }
+
+      a.reloadGprCache();
+      a.jmp(i->second);
+   }
+
+   // Checked slow paths for fastmem accesses, the guest address is in ecx
+   //   and the value in rax.  RDI is callee saved and otherwise unused.
+   for (auto &site : a.fastmemSites) {
+      a.bind(site.slowPath);
+      a.flushGprCache();
+      a.mov(asmjit::x86::edi, a.ecx);
+
+      if (site.write) {
+         a.mov(a.zdx, a.zax);
+      }
+
+      a.mov(a.zax, asmjit::Ptr(site.slowFn));
+      a.call(a.zax);
+      a.mov(a.ecx, asmjit::x86::edi);
+      a.reloadGprCache();
+      a.jmp(site.resume);
+   }
 
+   auto codeSize = a.getCodeSize();
    JitCode func = asmjit_cast<JitCode>(a.make());
    if (func == nullptr) {
       gLog->error("JIT failed due to asmjit make failure");
       return false;
    }
 
+   auto funcAddr = reinterpret_cast<uintptr_t>(func);
+   JitCodeRange range;
+   range.end = funcAddr + codeSize;
+   range.pcMap = block.pcMap;
+   range.firstPage = block.start / Memory::HostPageSize;
+   range.lastPage = (block.end - 1) / Memory::HostPageSize;
+   block.code = funcAddr;
+
+   if (profile) {
+      profile->hostSize = static_cast<uint32_t>(codeSize);
+   }
+
+   if (!mPerfMapPath.empty()) {
+      mPerfMap.add(getBlockName(block.start), func, codeSize);
+   }
+
+   for (auto &site : a.fastmemSites) {
+      auto start = static_cast<uint32_t>(a.getLabelOffset(site.start));
+      auto access = static_cast<uint32_t>(a.getLabelOffset(site.access));
+      auto slowPath = static_cast<uint32_t>(a.getLabelOffset(site.slowPath));
+      range.fastmem.push_back({ start, access, slowPath, 0 });
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mPageMutex);
+      mCodeRanges[funcAddr] = std::move(range);
+   }
+
+   mStats.blocks++;
+   mStats.guestInstructions += block.pcMap.size();
+   mStats.hostBytes += codeSize;
+
    auto baseAddr = asmjit_cast<JitCode>(func, a.getLabelOffset(codeStart));
    block.entry = baseAddr;
-   for (auto i = jumpLabels.cbegin(); i != jumpLabels.cend(); ++i) {
+   for (auto i = a.entryLabels.cbegin(); i != a.entryLabels.cend(); ++i) {
       block.targets[i->first] = asmjit_cast<JitCode>(func, a.getLabelOffset(i->second));
    }
+
+   for (auto &cache : a.inlineCaches) {
+      mInlineCaches.push_back(asmjit_cast<JitInlineCache *>(func, a.getLabelOffset(cache.second)));
+   }
+
+   for (auto& link : a.blockLinks) {
+      block.links.push_back({ link.first, asmjit_cast<JitCode*>(func, a.getLabelOffset(link.second)) });
+   }
    
    return true;
 }
@@ -510,6 +2493,50 @@ uint32_t JitManager::execute(ThreadState *state, JitCode block) {
    return mCallFn(state, block);
 }
 
+// The epoch has to be visible before the thread looks up any code, and
+//   shadow return stack entries may point at code retired since it last
+//   entered so they are dropped.
+void JitManager::enterCode(ThreadState *state) {
+   auto epoch = mRetireEpoch.load();
+   if (state->jitEpoch == epoch) {
+      return;
+   }
+
+   getJitEpoch(state).store(epoch);
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+
+   for (auto &entry : state->returnStack) {
+      entry.generation = 0;
+   }
+}
+
+void JitManager::leaveCode(ThreadState *state) {
+   getJitEpoch(state).store(0, std::memory_order_release);
+}
+
+JitCodeScope::JitCodeScope(ThreadState *state) :
+   mState(state),
+   mOuter(state->jitEpoch == 0)
+{
+   if (mOuter) {
+      gJitManager.enterCode(mState);
+   }
+}
+
+JitCodeScope::~JitCodeScope()
+{
+   if (mOuter) {
+      gJitManager.leaveCode(mState);
+   }
+}
+
+void JitCodeScope::refresh()
+{
+   if (mOuter) {
+      gJitManager.enterCode(mState);
+   }
+}
+
 bool PPCEmuAssembler::ErrorHandler::handleError(asmjit::Error code, const char* message) {
    gLog->error("ASMJit Error {}: {}\n", code, message);
    return true;
@@ -1,5 +1,16 @@
 #pragma once
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 #include <asmjit/asmjit.h>
 #include "memory.h"
 #include "instruction.h"
@@ -16,19 +27,51 @@
    registerInstruction(InstructionID::x, &jit_fallback)
 
 static const bool JIT_CONTINUE_ON_ERROR = false;
+static const bool JIT_TRACE_KERNEL_CALLS = false;
 static const int JIT_MAX_INST = 20000;
+static const int JIT_GPR_CACHE_SIZE = 8;
+static const uint32_t JIT_HOT_THRESHOLD = 32;
+static const uint32_t JIT_FASTMEM_PATCH_THRESHOLD = 8;
+static const uint32_t JIT_INLINE_CACHE_SIZE = 4;
+
+// Bump whenever a change to identBlock makes saved block caches stale
+static const uint32_t JIT_CACHE_VERSION = 1;
+
+// Exact generates native SSE2 code which updates FPSCR and FPRF after every
+//   scalar float instruction, operands which can set an invalid operation
+//   bit (infinities, zeroes and NaNs) still go to the interpreter.  Fast
+//   only writes the FPSCR exception bits and FPRF before something may
+//   observe them, a branch, jump target, fallback or FPSCR reader, and
+//   only record forms set the invalid operation bits.  Paired single code in Fast
+//   blocks which do not read FPSCR skips FPSCR tracking entirely.
+enum class JitFloatMode {
+   Exact,
+   Fast
+};
+
+// Optional host instruction set extensions, detected by initialise.  The
+//   emitters fall back to baseline x86-64 for any which are missing or
+//   disabled with disableCpuFeatures.
+enum JitCpuFeature
+{
+   JitCpuMovbe = 1 << 0, // Byte swapping loads and stores
+   JitCpuLzcnt = 1 << 1, // cntlzw
+   JitCpuBmi1 = 1 << 2, // andn
+   JitCpuBmi2 = 1 << 3, // rorx
+   JitCpuAvx = 1 << 4, // Detected only, nothing uses VEX encodings yet
+};
 
 /*
 Register Assignments:
    RAX . Scratch
    RCX . Scratch
    RDX . Scratch
-   RDI . Scratch
+   RDI . Unused, CIA is only stored to ThreadState where it is observable
    RSI . gMemory.base()
    RBX . ThreadState*
    RBP . 
    RSP . Emu Stack Pointer.
-   R8-R15 . PPCGPR Storage
+   R8-R15 . PPCGPR Storage, see PPCEmuAssembler::setGprCache
 */
 
 class PPCEmuAssembler : public asmjit::X86Assembler {
@@ -47,8 +90,16 @@ public:
       eax = zax.r32();
       ecx = zcx.r32();
       edx = zdx.r32();
-      r8d = asmjit::x86::r8d;
-      r9d = asmjit::x86::r9d;
+
+      gprCacheRegs[0] = asmjit::x86::r8d;
+      gprCacheRegs[1] = asmjit::x86::r9d;
+      gprCacheRegs[2] = asmjit::x86::r10d;
+      gprCacheRegs[3] = asmjit::x86::r11d;
+      gprCacheRegs[4] = asmjit::x86::r12d;
+      gprCacheRegs[5] = asmjit::x86::r13d;
+      gprCacheRegs[6] = asmjit::x86::r14d;
+      gprCacheRegs[7] = asmjit::x86::r15d;
+      setGprCache({});
 
 #define PPCTSReg(mm) asmjit::X86Mem(zbx, (int32_t)offsetof(ThreadState, mm), sizeof(ThreadState::mm))
       for (auto i = 0; i < 32; ++i) {
@@ -58,7 +109,9 @@ public:
          ppcfpr[i] = PPCTSReg(fpr[i]);
          ppcfprps[i][0] = PPCTSReg(fpr[i].paired0);
          ppcfprps[i][1] = PPCTSReg(fpr[i].paired1);
+         ppcfpriw[i] = PPCTSReg(fpr[i].iw0);
       }
+      ppccia = PPCTSReg(cia);
       ppccr = PPCTSReg(cr);
       ppcxer = PPCTSReg(xer.value);
       ppclr = PPCTSReg(lr);
@@ -70,14 +123,19 @@ public:
       ppcreserve = PPCTSReg(reserve);
       ppcreserveAddress = PPCTSReg(reserveAddress);
       ppcreserveData = PPCTSReg(reserveData);
+      ppcprofileBlock = PPCTSReg(profileBlock);
+      ppcprofileStart = PPCTSReg(profileStart);
+      ppcreturnStackTop = PPCTSReg(returnStackTop);
+      ppcinterruptMask = PPCTSReg(interruptMask);
 #undef PPCTSReg
 
       state = zbx;
       membase = zsi;
-      cia = zdi;
 
       xmm0 = asmjit::x86::xmm0;
       xmm1 = asmjit::x86::xmm1;
+      xmm2 = asmjit::x86::xmm2;
+      xmm3 = asmjit::x86::xmm3;
    }
 
    void shiftTo(asmjit::X86GpReg reg, int s, int d) {
@@ -88,22 +146,189 @@ public:
       }
    }
 
+   // Assign guest GPRs to the host cache registers for the block being
+   //   generated.  Cached GPRs only live in R8-R15 while inside the block,
+   //   flushGprCache must be called before anything which reads or writes
+   //   ThreadState::gpr (fallbacks, kernel calls, leaving the block) and
+   //   reloadGprCache once execution continues in the block.
+   void setGprCache(const std::vector<uint32_t>& gprs) {
+      for (auto i = 0; i < 32; ++i) {
+         gprCacheSlot[i] = -1;
+      }
+
+      gprCacheList.clear();
+      for (auto r : gprs) {
+         assert(gprCacheList.size() < JIT_GPR_CACHE_SIZE);
+         gprCacheSlot[r] = static_cast<int>(gprCacheList.size());
+         gprCacheList.push_back(r);
+      }
+   }
+
+   bool isGprCached(uint32_t r) const {
+      return gprCacheSlot[r] >= 0;
+   }
+
+   void loadGpr(const asmjit::X86GpReg& reg, uint32_t r) {
+      if (isGprCached(r)) {
+         mov(reg, gprCacheRegs[gprCacheSlot[r]]);
+      } else {
+         mov(reg, ppcgpr[r]);
+      }
+   }
+
+   void storeGpr(uint32_t r, const asmjit::X86GpReg& reg) {
+      if (isGprCached(r)) {
+         mov(gprCacheRegs[gprCacheSlot[r]], reg);
+      } else {
+         mov(ppcgpr[r], reg);
+      }
+   }
+
+   void addGpr(const asmjit::X86GpReg& reg, uint32_t r) {
+      if (isGprCached(r)) {
+         add(reg, gprCacheRegs[gprCacheSlot[r]]);
+      } else {
+         add(reg, ppcgpr[r]);
+      }
+   }
+
+   void flushGprCache() {
+      for (auto i = 0u; i < gprCacheList.size(); ++i) {
+         mov(ppcgpr[gprCacheList[i]], gprCacheRegs[i]);
+      }
+   }
+
+   void reloadGprCache() {
+      for (auto i = 0u; i < gprCacheList.size(); ++i) {
+         mov(gprCacheRegs[i], ppcgpr[gprCacheList[i]]);
+      }
+   }
+
+   // CIA is not kept up to date while in JIT code, this stores it for
+   //   the instruction being generated before anything which may read it.
+   void storeCia() {
+      mov(ppccia, genCia);
+   }
+
    asmjit::X86GpReg state;
    asmjit::X86GpReg membase;
-   asmjit::X86GpReg cia;
 
    asmjit::X86GpReg eax;
    asmjit::X86GpReg ecx;
    asmjit::X86GpReg edx;
-   asmjit::X86GpReg r8d;
-   asmjit::X86GpReg r9d;
+
+   asmjit::X86GpReg gprCacheRegs[JIT_GPR_CACHE_SIZE];
+   int gprCacheSlot[32];
+   std::vector<uint32_t> gprCacheList;
+
+   // Block exits to a known guest address, the label marks the 8 byte
+   //   slot holding the host address the exit jumps through.
+   std::vector<std::pair<uint32_t, asmjit::Label>> blockLinks;
+
+   // Entry points gen emits for the block's jump targets, calls push the
+   //   one for their return address onto the shadow return stack.
+   std::map<uint32_t, asmjit::Label> entryLabels;
+
+   // bcctr inline caches, the label marks the JitInlineCache embedded in
+   //   the code for the bcctr at that guest address.
+   std::vector<std::pair<uint32_t, asmjit::Label>> inlineCaches;
+
+   // Whether the block counts inline cache hits and misses
+   bool profiling = false;
+
+   // See JitBlock::isolated
+   bool isolated = false;
+
+   // Lazy condition register for a compare feeding straight into a bc.
+   //   gen sets crFuseField when the next instruction is a bc testing that
+   //   CR field, the compare then only sets the host flags and records the
+   //   field in pendingCrField.  The bc branches on the flags and writes
+   //   the field only on the paths where crLiveTaken/crLiveFallthrough say
+   //   something may still read it.
+   int crFuseField = -1;
+   int pendingCrField = -1;
+   bool pendingCrUnsigned = false;
+   bool crLiveTaken = true;
+   bool crLiveFallthrough = true;
+
+   // Set by gen when the cr0 or XER[CA] written by the current instruction
+   //   is overwritten before anything can read it, see isCrfDead.
+   bool cr0Dead = false;
+   bool carryDead = false;
+
+   // GPRs holding a value known at compile time before the current
+   //   instruction, tracked by gen through straight line code so emitters
+   //   can fold li/lis/addi chains and constant addresses.
+   uint32_t knownGprs = 0;
+   uint32_t knownGprValues[32];
+
+   bool isGprKnown(uint32_t r) const {
+      return (knownGprs >> r) & 1;
+   }
+
+   void setGprKnown(uint32_t r, uint32_t value) {
+      knownGprs |= 1u << r;
+      knownGprValues[r] = value;
+   }
+
+   // Guest address of the instruction being generated
+   uint32_t genCia = 0;
+
+   // Set by gen when the bc being generated closes a loop found by
+   //   isIdleLoop, the taken path then calls Processor::idleLoop.
+   bool idleLoop = false;
+
+   // Unchecked guest memory access, gen emits a slow path for each one
+   //   which a host fault on access (or a jmp patched over start) leads to.
+   struct FastmemSite {
+      FastmemSite(PPCEmuAssembler& a) :
+         start(a), access(a), resume(a), slowPath(a)
+      {
+      }
+
+      asmjit::Label start;
+      asmjit::Label access;
+      asmjit::Label resume;
+      asmjit::Label slowPath;
+      const void *slowFn = nullptr;
+      uint32_t cia = 0;
+      bool write = false;
+   };
+
+   std::vector<FastmemSite> fastmemSites;
+
+   // Whether the paired single emitters may skip FPSCR tracking in this
+   //   block, true in JitFloatMode::Fast when nothing in it reads FPSCR.
+   bool fastFloat = false;
+
+   // Scalar float code generated for this block
+   JitFloatMode floatMode = JitFloatMode::Exact;
+
+   // JitFloatMode::Fast leaves the FPSCR update of native scalar float code
+   //   pending until something may observe it, see flushFloatStatus.
+   //   fprfPending is the FPR to set FPRF from, -1 if FPRF is up to date.
+   bool fpscrPending = false;
+   int fprfPending = -1;
+   bool fprfPendingSingle = false;
+
+   // JitCpuFeature flags the emitters may use
+   uint32_t cpuFeatures = 0;
+
+   // GQR values when the block was compiled, psq_l/psq_st are specialised
+   //   on these and check the live GQR still matches before using it.
+   bool gqrKnown = false;
+   gqr_t gqr[8];
 
    asmjit::X86XmmReg xmm0;
    asmjit::X86XmmReg xmm1;
+   asmjit::X86XmmReg xmm2;
+   asmjit::X86XmmReg xmm3;
 
    asmjit::X86Mem ppcgpr[32];
    asmjit::X86Mem ppcfpr[32];
    asmjit::X86Mem ppcfprps[32][2];
+   asmjit::X86Mem ppcfpriw[32];
+   asmjit::X86Mem ppccia;
    asmjit::X86Mem ppccr;
    asmjit::X86Mem ppcxer;
    asmjit::X86Mem ppclr;
@@ -114,6 +339,11 @@ public:
    asmjit::X86Mem ppcreserve;
    asmjit::X86Mem ppcreserveAddress;
    asmjit::X86Mem ppcreserveData;
+
+   asmjit::X86Mem ppcprofileBlock;
+   asmjit::X86Mem ppcprofileStart;
+   asmjit::X86Mem ppcreturnStackTop;
+   asmjit::X86Mem ppcinterruptMask;
 };
 
 template<typename T, typename Z>
@@ -129,18 +359,225 @@ typedef uint32_t(*JitCall)(ThreadState*, JitCode);
 
 typedef std::map<uint32_t, asmjit::Label> JumpLabelMap;
 
+// Targets seen by one bcctr, embedded in the generated code after it.
+//   Entries are only ever filled in, never replaced, so other cores can
+//   match a target and jump through its host slot without locking.  The
+//   host slots are block links, unlinked slots point at the finale.
+struct JitInlineCache {
+   static const uint32_t Empty = 1;
+
+   uint32_t targets[JIT_INLINE_CACHE_SIZE];
+   JitCode hosts[JIT_INLINE_CACHE_SIZE];
+   uint64_t hits;
+   uint64_t misses;
+   uint32_t cia;
+   uint32_t used;
+};
+
+struct JitInlineCacheStats {
+   uint32_t cia;
+   uint32_t targets;
+   uint64_t hits;
+   uint64_t misses;
+};
+
+// Guest address to host code lookup.  The first level is indexed by the
+//   upper 16 bits of the address and second level tables are only
+//   allocated for 64KB guest pages which contain compiled code.
+//
+// Reads are lock free and may happen on any core while another core is
+//   writing, writes are published with release stores but have to be
+//   serialised by the owner.  clear frees the second level tables so it
+//   must only be called while nothing is reading.
+class JitCodeTable {
+public:
+   static const uint32_t L1Size = 0x10000;
+   static const uint32_t L2Size = 0x4000;
+
+   JitCodeTable();
+   ~JitCodeTable();
+
+   // Returns the entry for addr or nullptr when none has been compiled
+   JitCode get(uint32_t addr) const;
+
+   // Whether addr has an entry or has been marked as failed
+   bool contains(uint32_t addr) const;
+
+   void set(uint32_t addr, JitCode code);
+   void setFailed(uint32_t addr);
+   void erase(uint32_t addr);
+   void clear();
+
+   // First level table, used by the dispatcher stub.  Failed entries are
+   //   stored as JitCodeTable::Failed so anything <= Failed is a miss.
+   const void *root() const {
+      return mTable;
+   }
+
+   static const uintptr_t Failed = 1;
+
+private:
+   typedef std::atomic<JitCode> Entry;
+   static_assert(sizeof(Entry) == sizeof(JitCode), "dispatcher reads entries as plain pointers");
+
+   Entry &entry(uint32_t addr);
+
+   std::atomic<Entry *> *mTable;
+};
+
+// Interpreter execution counts of block entry addresses, laid out like
+//   JitCodeTable.  Every core updates the counters without locking.
+class JitCounterTable {
+public:
+   JitCounterTable();
+   ~JitCounterTable();
+
+   // Returns the count including this execution
+   uint32_t increment(uint32_t addr);
+   void reset(uint32_t addr);
+   void clear();
+
+   // Raise the count to at least count
+   void seed(uint32_t addr, uint32_t count);
+
+private:
+   typedef std::atomic<uint32_t> Counter;
+
+   Counter &getCounter(uint32_t addr);
+
+   std::atomic<Counter *> *mTable;
+};
+
+// Pairs of host code offset and guest address, sorted by offset
+typedef std::vector<std::pair<uint32_t, uint32_t>> JitPcMap;
+
+struct JitLink {
+   uint32_t target;
+   JitCode *slot;
+};
+
 struct JitBlock {
    JitBlock(uint32_t _start) {
       start = _start;
       end = _start;
+      code = 0;
       entry = nullptr;
+      gqrKnown = false;
+      isolated = false;
    }
 
    uint32_t start;
    uint32_t end;
 
+   // Every exit returns to the interpreter loop, no links, dispatcher,
+   //   inline caches or shadow return stack.
+   bool isolated;
+
+   // Words between start and end which no path through the function
+   //   reaches, such as padding or jump tables.  No code is generated.
+   std::set<uint32_t> unreachable;
+
+   // GQR values to specialise psq_l/psq_st on
+   bool gqrKnown;
+   gqr_t gqr[8];
+
+   // Start of the generated code, the key of its JitCodeRange
+   uintptr_t code;
+
    JitCode entry;
    std::map<uint32_t, JitCode> targets;
+   std::vector<JitLink> links;
+
+   // Host code offset to the guest address it was generated for
+   JitPcMap pcMap;
+};
+
+// A block compiled for Interpreter::verifyBlock, entry is the isolated
+//   code for the address it was requested for.
+struct JitVerifyBlock {
+   uint32_t start;
+   uint32_t end;
+   JitCode entry;
+
+   // Addresses branches inside the block jump to without leaving it
+   std::set<uint32_t> targets;
+};
+
+// Host code offsets of a fastmem access, see PPCEmuAssembler::FastmemSite
+struct JitFastmemSite {
+   uint32_t start;
+   uint32_t access;
+   uint32_t slowPath;
+   uint32_t faults;
+};
+
+// Generated code of one block, used to find the guest address for a
+//   host address in JIT code.
+struct JitCodeRange {
+   uintptr_t end;
+   JitPcMap pcMap;
+   std::vector<JitFastmemSite> fastmem;
+
+   // Guest code pages the block was generated from
+   uint32_t firstPage;
+   uint32_t lastPage;
+
+   // Unreachable and waiting in mRetired to be freed
+   bool retired = false;
+};
+
+struct JitStats {
+   uint64_t blocks = 0;
+   uint64_t guestInstructions = 0;
+   uint64_t hostBytes = 0;
+};
+
+// Execution profile of one block, the counters are updated by the
+//   generated code without locking so they are approximate.
+struct JitProfileEntry {
+   uint32_t start = 0;
+   uint32_t hostSize = 0;
+   uint64_t count = 0;
+   uint64_t cycles = 0;
+};
+
+// Describes generated code to host profilers, a perf-<pid>.map for perf
+//   report and a jit-<pid>.dump for perf inject.
+class JitPerfMap {
+public:
+   ~JitPerfMap();
+
+   bool open(const std::string &dir);
+   void close();
+   void add(const std::string &name, const void *code, size_t size);
+
+private:
+   std::FILE *mMap = nullptr;
+   std::FILE *mDump = nullptr;
+   void *mMarker = nullptr;
+   uint64_t mCodeIndex = 0;
+};
+
+enum class JitProfileMode {
+   Disabled,
+   Count, // Block entries
+   Time, // Block entries and rdtsc cycles until the next block entry
+};
+
+// Marks a thread as possibly running JIT code, or holding code returned
+//   by lookup or get, so code retired meanwhile is not freed under it.
+//   Only the outermost scope on a thread counts, refresh may only be
+//   called where no code entered within the scope is still running.
+class JitCodeScope {
+public:
+   JitCodeScope(ThreadState *state);
+   ~JitCodeScope();
+
+   void refresh();
+
+private:
+   ThreadState *mState;
+   bool mOuter;
 };
 
 class JitManager {
@@ -149,29 +586,192 @@ public:
    ~JitManager();
 
    bool initialise();
+   void shutdown();
 
    void initStubs();
    void clearCache();
    bool prepare(uint32_t addr);
    JitCode get(uint32_t addr);
    JitCode getSingle(uint32_t addr);
+   const JitVerifyBlock *getVerify(uint32_t addr);
+   JitCode lookup(uint32_t addr);
+   void invalidate(uint32_t addr);
+   bool invalidateRange(uint32_t addr, uint32_t size);
+
+   // Write protect a code page the interpreter has predecoded, a write to
+   //   it invalidates it like a page with compiled code.  decoded is only
+   //   set once the protection is in place.
+   void protectCodePage(uint32_t page, std::atomic<bool> *decoded);
    uint32_t execute(ThreadState *state, JitCode block);
 
+   // Used by JitCodeScope
+   void enterCode(ThreadState *state);
+   void leaveCode(ThreadState *state);
+
+   void addFunction(uint32_t start, uint32_t size);
+   void addSymbol(uint32_t addr, const std::string &name);
+
+   // Must be called before initialise, dir is where the perf files go
+   void setPerfMapPath(const std::string &dir);
+
+   // Without linking every block exit goes back to the interpreter loop,
+   //   so it sees every block entry.  Must be set before initialise.
+   void setBlockLinking(bool enabled);
+
+   void setCachePath(const std::string &path);
+   void loadCache(const std::string &name, uint32_t start, uint32_t end);
+   void saveCache();
+
+   void setFloatMode(JitFloatMode mode);
+
+   JitFloatMode getFloatMode() const {
+      return mFloatMode;
+   }
+
+   // Takes a comma separated list of movbe, lzcnt, bmi1, bmi2, avx or all,
+   //   must be called before initialise.
+   bool disableCpuFeatures(const std::string &names);
+
+   uint32_t getCpuFeatures() const {
+      return mCpuFeatures;
+   }
+
+   uint32_t getGuestAddress(const void *host);
+   bool handleAccessFault(uintptr_t &hostPc, ppcaddr_t address, bool write);
+
+   // Totals since startup, not reset by clearCache
+   const JitStats &getStats() const {
+      return mStats;
+   }
+
+   // Must be set before initialise
+   void setProfileMode(JitProfileMode mode);
+
+   JitProfileMode getProfileMode() const {
+      return mProfileMode;
+   }
+
+   // Snapshot of every profiled block, sorted by cycles then count
+   std::vector<JitProfileEntry> getProfile();
+
+   // Every bcctr inline cache since the last clearCache, sorted by
+   //   executions.  Hits and misses are only counted while profiling.
+   std::vector<JitInlineCacheStats> getInlineCacheStats();
+
+   // Called from generated code on an inline cache miss
+   void fillInlineCache(JitInlineCache *cache, uint32_t target);
+
    static bool hasInstruction(InstructionID id);
 
 private:
+   JitCode compile(uint32_t addr, const gqr_t *gqr);
+   void queueCompile(uint32_t addr);
+   void compileThreadEntry();
    bool identBlock(JitBlock& block);
+   bool identFunction(JitBlock& block);
+   std::string getBlockName(uint32_t addr);
    bool gen(JitBlock& block);
+   void linkBlock(JitBlock& block);
+   void unlink(uint32_t addr);
+   void protectBlock(const JitBlock& block);
+   bool invalidatePage(uint32_t page);
+   void eraseBlock(uint32_t addr);
+   void retireCode(uintptr_t base);
+   void reclaimCode();
+   std::unique_ptr<JitVerifyBlock> genVerify(uint32_t addr, uint32_t generation);
    bool jit_b(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels);
    bool jit_bc(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels);
    bool jit_bcctr(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels);
    bool jit_bclr(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels);
 
    asmjit::JitRuntime* mRuntime;
-   std::map<uint32_t, JitCode> mBlocks;
-   std::map<uint32_t, JitCode> mSingleBlocks;
+   // Held while compiling or modifying anything below, lookups through
+   //   mBlocks do not need it.
+   std::recursive_mutex mMutex;
+
+   // Held while using mCodePages, mPageCode, mCodeRanges, mRetired, mLinks
+   //   or mVerifyBlocks.
+   //   It is never held while generating code, so the write and access
+   //   fault handlers which take it only wait for short updates.  Taken
+   //   after mMutex when both are needed.
+   std::mutex mPageMutex;
+
+   JitCodeTable mBlocks;
+   JitCodeTable mSingleBlocks;
+   std::map<uint32_t, std::unique_ptr<JitVerifyBlock>> mVerifyBlocks;
+   bool mBlockLinking = true;
+
+   // Bumped whenever compiled code may no longer match guest memory, shadow
+   //   return stack entries from an older generation are ignored.
+   std::atomic<uint32_t> mGeneration { 1 };
+   std::map<uint32_t, std::vector<JitCode*>> mLinks;
+
+   // Guest code page to the entry points of every block which covers it,
+   //   pages in here are write protected until invalidated.
+   std::map<uint32_t, std::set<uint32_t>> mCodePages;
+
+   // Guest code page to the generated code of every block which covers
+   //   it, retired when the page is invalidated.
+   std::map<uint32_t, std::set<uintptr_t>> mPageCode;
+
+   // Invalidated code some thread may still be running, freed once every
+   //   ThreadState::jitEpoch is past the epoch it was retired in.
+   struct RetiredCode {
+      uintptr_t base;
+      uint32_t epoch;
+   };
+
+   std::vector<RetiredCode> mRetired;
+   uint64_t mRetiredBytes = 0;
+   std::atomic<uint32_t> mRetireEpoch { 1 };
+
+   // Hot addresses waiting for the background compiler
+   struct CompileRequest {
+      uint32_t addr;
+      bool gqrKnown;
+      gqr_t gqr[8];
+   };
+
+   // Function entry points found by the loader, to the function size if
+   //   known, otherwise 0.
+   std::map<uint32_t, uint32_t> mFunctions;
+
+   // Guest code symbols for naming blocks in the perf map
+   std::map<uint32_t, std::string> mSymbols;
+   std::string mPerfMapPath;
+   JitPerfMap mPerfMap;
+
+   // Code sections which get their block list saved by saveCache
+   struct CachedModule {
+      std::string name;
+      uint32_t start;
+      uint32_t end;
+      uint32_t hash;
+   };
+
+   std::string mCachePath;
+   std::vector<CachedModule> mCachedModules;
+
+   JitCounterTable mCounters;
+   std::thread mCompileThread;
+   std::mutex mQueueMutex;
+   std::condition_variable mQueueCond;
+   std::deque<CompileRequest> mQueue;
+   bool mStopCompileThread = false;
    JitCall mCallFn;
    JitFinale mFinaleFn;
+   JitFinale mDispatchFn;
+   JitFloatMode mFloatMode;
+   uint32_t mCpuFeatures = 0;
+   uint32_t mDisabledCpuFeatures = 0;
+
+   // Kept across recompiles and clearCache, the generated code points here
+   JitProfileMode mProfileMode = JitProfileMode::Disabled;
+   std::map<uint32_t, std::unique_ptr<JitProfileEntry>> mProfile;
+
+   std::map<uintptr_t, JitCodeRange> mCodeRanges;
+   std::vector<JitInlineCache *> mInlineCaches;
+   JitStats mStats;
 
 public:
    static void RegisterFunctions();
@@ -189,5 +789,7 @@ private:
 };
 
 bool jit_fallback(PPCEmuAssembler& a, Instruction instr);
+void setCRFFromFlags(PPCEmuAssembler& a, uint32_t crf, bool isUnsigned);
+void jumpOnCRB(PPCEmuAssembler& a, uint32_t crb, bool value, bool isUnsigned, const asmjit::Label& label);
 
 extern JitManager gJitManager;
@@ -1,3 +1,4 @@
+#include <cassert>
 #include "bitutils.h"
 #include "jit.h"
 
@@ -29,6 +30,86 @@ void setCRB(PPCEmuAssembler& a, uint32_t bit, const asmjit::X86GpReg& value, con
    a.mov(a.ppccr, tmp);
 }
 
+// Write CR field crf from the host flags of a `cmp a, b`
+void setCRFFromFlags(PPCEmuAssembler& a, uint32_t crf, bool isUnsigned)
+{
+   uint32_t crshift = (7 - crf) * 4;
+
+   // mov does not touch the flags, so collect the results in al/ah/cl
+   //   first (R8-R15 hold cached GPRs)
+   a.mov(a.eax, 0);
+   a.mov(a.ecx, 0);
+   if (isUnsigned) {
+      a.seta(a.eax.r8Lo());
+      a.setb(a.eax.r8Hi());
+   } else {
+      a.setg(a.eax.r8Lo());
+      a.setl(a.eax.r8Hi());
+   }
+   a.sete(a.ecx.r8());
+
+   // Load and mask CRF
+   a.mov(a.edx, a.ppccr);
+   a.and_(a.edx, ~(0xF << crshift));
+
+   a.shl(a.ecx, crshift + ConditionRegisterFlag::ZeroShift);
+   a.or_(a.edx, a.ecx);
+
+   a.movzx(a.ecx, a.eax.r8Lo());
+   a.shl(a.ecx, crshift + ConditionRegisterFlag::PositiveShift);
+   a.or_(a.edx, a.ecx);
+
+   a.movzx(a.ecx, a.eax.r8Hi());
+   a.shl(a.ecx, crshift + ConditionRegisterFlag::NegativeShift);
+   a.or_(a.edx, a.ecx);
+
+   // Summary Overflow
+   a.mov(a.ecx, a.ppcxer);
+   a.and_(a.ecx, XERegisterBits::StickyOV);
+   a.shiftTo(a.ecx, XERegisterBits::StickyOVShift, crshift + ConditionRegisterFlag::SummaryOverflowShift);
+   a.or_(a.edx, a.ecx);
+
+   a.mov(a.ppccr, a.edx);
+}
+
+// Jump to label if CR bit crb (0 = lt, 1 = gt, 2 = eq) of the field
+//   described by the host flags is equal to value
+void jumpOnCRB(PPCEmuAssembler& a, uint32_t crb, bool value, bool isUnsigned, const asmjit::Label& label)
+{
+   if (crb == 0 && value) {
+      if (isUnsigned) {
+         a.jb(label);
+      } else {
+         a.jl(label);
+      }
+   } else if (crb == 0 && !value) {
+      if (isUnsigned) {
+         a.jae(label);
+      } else {
+         a.jge(label);
+      }
+   } else if (crb == 1 && value) {
+      if (isUnsigned) {
+         a.ja(label);
+      } else {
+         a.jg(label);
+      }
+   } else if (crb == 1 && !value) {
+      if (isUnsigned) {
+         a.jbe(label);
+      } else {
+         a.jle(label);
+      }
+   } else if (crb == 2 && value) {
+      a.je(label);
+   } else if (crb == 2 && !value) {
+      a.jne(label);
+   } else {
+      // Summary overflow is not in the host flags
+      assert(0);
+   }
+}
+
 // Compare
 enum CmpFlags
 {
@@ -39,25 +120,7 @@ template<typename Type, unsigned flags = 0>
 static bool
 cmpGeneric(PPCEmuAssembler& a, Instruction instr)
 {
-   uint32_t crshift = (7 - instr.crfD) * 4;
-
-   // Load CRF
-   a.mov(a.edx, a.ppccr);
-   
-   // Mask CRF
-   uint32_t mask = 0xFFFFFFFF;
-   mask &= ~(0xF << crshift);
-   a.and_(a.edx, mask);
-
-   // Summary Overflow
-   a.mov(a.eax, a.ppcxer);
-   a.and_(a.eax, XERegisterBits::StickyOV);
-   a.shr(a.eax, XERegisterBits::StickyOVShift);
-   a.shl(a.eax, ConditionRegisterFlag::SummaryOverflowShift << crshift);
-   a.or_(a.edx, a.eax);
-
-   // Perform Comparison
-   a.mov(a.eax, a.ppcgpr[instr.rA]);
+   a.loadGpr(a.eax, instr.rA);
 
    if (flags & CmpImmediate) {
       if (std::is_signed<Type>::value) {
@@ -66,38 +129,19 @@ cmpGeneric(PPCEmuAssembler& a, Instruction instr)
          a.mov(a.ecx, instr.uimm);
       }
    } else {
-      a.mov(a.ecx, a.ppcgpr[instr.rB]);
+      a.loadGpr(a.ecx, instr.rB);
    }
 
    a.cmp(a.eax, a.ecx);
-   a.mov(a.r8d, 0);
-   if (std::is_unsigned<Type>::value) {
-      a.seta(a.r8d.r8());
-   } else {
-      a.setg(a.r8d.r8());
-   }
-   a.mov(a.r9d, 0);
-   if (std::is_unsigned<Type>::value) {
-      a.setb(a.r9d.r8());
+
+   if (a.crFuseField == static_cast<int>(instr.crfD)) {
+      // The following bc will use the host flags directly
+      a.pendingCrField = instr.crfD;
+      a.pendingCrUnsigned = std::is_unsigned<Type>::value;
    } else {
-      a.setl(a.r9d.r8());
+      setCRFFromFlags(a, instr.crfD, std::is_unsigned<Type>::value);
    }
 
-   a.mov(a.ecx, 0);
-   a.sete(a.ecx.r8());
-   a.shl(a.ecx, crshift + ConditionRegisterFlag::ZeroShift);
-   a.or_(a.edx, a.ecx);
-
-   a.mov(a.ecx, a.r8d);
-   a.shl(a.ecx, crshift + ConditionRegisterFlag::PositiveShift);
-   a.or_(a.edx, a.ecx);
-   
-   a.mov(a.ecx, a.r9d);
-   a.shl(a.ecx, crshift + ConditionRegisterFlag::NegativeShift);
-   a.or_(a.edx, a.ecx);
-
-   a.mov(a.ppccr, a.edx);
-
    return true;
 }
 
@@ -290,7 +334,7 @@ static bool
 mfcr(PPCEmuAssembler& a, Instruction instr)
 {
    a.mov(a.eax, a.ppccr);
-   a.mov(a.ppcgpr[instr.rD], a.eax);
+   a.storeGpr(instr.rD, a.eax);
    return true;
 }
 
@@ -306,7 +350,7 @@ mtcrf(PPCEmuAssembler& a, Instruction instr)
       }
    }
 
-   a.mov(a.eax, a.ppcgpr[instr.rS]);
+   a.loadGpr(a.eax, instr.rS);
    a.and_(a.eax, mask);
    a.mov(a.ecx, a.ppccr);
    a.and_(a.ecx, ~mask);
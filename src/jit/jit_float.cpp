@@ -1,42 +1,787 @@
+#include <cassert>
 #include "bitutils.h"
 #include "jit.h"
 #include "jit_float.h"
 
+// fpscr_t bits the native code updates
+enum FpscrBits : uint32_t
+{
+   FpscrFprfShift = 12,
+   FpscrFprf = 0x1Fu << FpscrFprfShift,
+   FpscrFI = 1u << 17,
+   FpscrFR = 1u << 18,
+   FpscrVXIMZ = 1u << 20,
+   FpscrVXZDZ = 1u << 21,
+   FpscrVXIDI = 1u << 22,
+   FpscrVXISI = 1u << 23,
+   FpscrVXSNAN = 1u << 24,
+   FpscrXX = 1u << 25,
+   FpscrZX = 1u << 26,
+   FpscrUX = 1u << 27,
+   FpscrOX = 1u << 28,
+   FpscrVX = 1u << 29,
+   FpscrFEX = 1u << 30,
+   FpscrFX = 1u << 31,
+
+   // vxsnan, vxisi, vxidi, vxzdz, vximz, vxvc, vxsoft, vxsqrt and vxcvi
+   FpscrVXDetail = 0x01F80700,
+};
+
+// FPSCR bits for the sticky host exception flags in MXCSR bits 2-5, zero
+//   divide, overflow, underflow and precision, see updateFPSCR.
+static uint32_t
+sMxcsrExceptions[16];
+
+// Doubles compared against this after (bits << 1) - 1 are infinities,
+//   zeroes or NaNs, the only operands the invalid operation checks of the
+//   interpreter can be true for.
+static const uint64_t SpecialDoubleLimit = 0xFFDFFFFFFFFFFFFFull;
+
+// Stack slot above the call shadow space reserved by initStubs
+static asmjit::X86Mem
+getScratchSlot(PPCEmuAssembler& a)
+{
+   return asmjit::X86Mem(a.zsp, 0x20, 4);
+}
+
+// Jump to special if the double in rax is an infinity, zero or NaN, rdx
+//   has to hold SpecialDoubleLimit.  Clobbers rax.
+static void
+jumpIfSpecial(PPCEmuAssembler& a, asmjit::Label& special)
+{
+   a.add(a.zax, a.zax);
+   a.sub(a.zax, 1);
+   a.cmp(a.zax, a.zdx);
+   a.jae(special);
+}
+
+static void
+jumpIfSpecial(PPCEmuAssembler& a, uint32_t fr, asmjit::Label& special)
+{
+   a.mov(a.zax, a.ppcfprps[fr][0]);
+   jumpIfSpecial(a, special);
+}
+
+// reg = bit if reg is non-zero, otherwise 0
+static void
+setBitIfNonZero(PPCEmuAssembler& a, const asmjit::X86GpReg& reg, uint32_t bit)
+{
+   a.neg(reg);
+   a.sbb(reg, reg);
+   a.and_(reg, bit);
+}
+
+enum FPRFSource
+{
+   FPRFNone,
+   FPRFDouble, // Result in xmm0 as a double
+   FPRFSingle, // Result in xmm0 as a single
+};
+
+// ecx = FPRF of the result in xmm0 shifted into place, as updateFPRF sets
+//   it.  Clobbers rax and rdx.
+static void
+getResultFlags(PPCEmuAssembler& a, FPRFSource source)
+{
+   auto single = source == FPRFSingle;
+   auto value = single ? a.eax : a.zax;
+   auto limit = single ? a.edx : a.zdx;
+   auto signBit = single ? 31 : 63;
+   asmjit::Label nanLbl(a), infinityLbl(a), zeroLbl(a), denormalLbl(a), doneLbl(a);
+
+   if (single) {
+      a.movd(a.eax, a.xmm0);
+   } else {
+      a.movq(a.zax, a.xmm0);
+   }
+
+   a.bt(value, signBit);
+   a.sbb(a.ecx, a.ecx);
+   a.and_(a.ecx, FloatingPointResultFlags::Negative - FloatingPointResultFlags::Positive);
+   a.add(a.ecx, FloatingPointResultFlags::Positive);
+   a.btr(value, signBit);
+
+   if (single) {
+      a.mov(limit, 0x7F800000);
+   } else {
+      a.mov(limit, 0x7FF0000000000000ull);
+   }
+
+   a.cmp(value, limit);
+   a.ja(nanLbl);
+   a.je(infinityLbl);
+   a.test(value, value);
+   a.jz(zeroLbl);
+
+   if (single) {
+      a.mov(limit, 1u << 23);
+   } else {
+      a.mov(limit, 1ull << 52);
+   }
+
+   a.cmp(value, limit);
+   a.jb(denormalLbl);
+   a.jmp(doneLbl);
+
+   a.bind(nanLbl);
+   a.mov(a.ecx, FloatingPointResultFlags::ClassDescriptor | FloatingPointResultFlags::Unordered);
+   a.jmp(doneLbl);
+
+   a.bind(infinityLbl);
+   a.or_(a.ecx, FloatingPointResultFlags::Unordered);
+   a.jmp(doneLbl);
+
+   a.bind(zeroLbl);
+   a.or_(a.ecx, FloatingPointResultFlags::Equal);
+   a.jmp(doneLbl);
+
+   a.bind(denormalLbl);
+   a.or_(a.ecx, FloatingPointResultFlags::ClassDescriptor);
+
+   a.bind(doneLbl);
+   a.shl(a.ecx, FpscrFprfShift);
+}
+
+// Native updateFPSCR, and updateFPRF unless source is FPRFNone.  The
+//   detail bits in clear are the invalid operation bits the instruction
+//   assigns, they are all false for the operands native code handles.
+//   Clobbers rax, rcx and rdx.
+static void
+updateFloatStatus(PPCEmuAssembler& a, uint32_t clear, FPRFSource source)
+{
+   auto scratch = getScratchSlot(a);
+
+   // ux, ox, zx, fi and xx from the sticky host flags, fr from the host
+   //   rounding mode being upward or toward zero.
+   a.stmxcsr(scratch);
+   a.mov(a.ecx, scratch);
+   a.mov(a.edx, a.ecx);
+   a.shr(a.ecx, 2);
+   a.and_(a.ecx, 0xF);
+   a.mov(a.zax, asmjit::Ptr(sMxcsrExceptions));
+   a.mov(a.ecx, asmjit::X86Mem(a.zax, a.zcx, 2, 0, 4));
+   a.shr(a.edx, 14);
+   a.and_(a.edx, 1);
+   a.shl(a.edx, 18);
+   a.or_(a.ecx, a.edx);
+
+   a.mov(a.eax, a.ppcfpscr);
+   a.and_(a.eax, ~(clear | FpscrFI | FpscrFR));
+   a.or_(a.eax, a.ecx);
+
+   // fex uses vx from before this update, like the interpreter.  The
+   //   exception bits line up with their enable bits shifted by 22.
+   a.mov(a.ecx, a.eax);
+   a.shr(a.ecx, 22);
+   a.and_(a.ecx, a.eax);
+   a.and_(a.ecx, 0xF8);
+   setBitIfNonZero(a, a.ecx, FpscrFEX);
+   a.and_(a.eax, ~(FpscrVX | FpscrFEX | FpscrFX));
+   a.or_(a.eax, a.ecx);
+
+   a.mov(a.ecx, a.eax);
+   a.and_(a.ecx, FpscrVXDetail);
+   setBitIfNonZero(a, a.ecx, FpscrVX);
+   a.or_(a.eax, a.ecx);
+
+   a.mov(a.ecx, a.eax);
+   a.and_(a.ecx, FpscrVX | FpscrOX | FpscrUX | FpscrZX | FpscrXX);
+   setBitIfNonZero(a, a.ecx, FpscrFX);
+   a.or_(a.eax, a.ecx);
+   a.mov(a.ppcfpscr, a.eax);
+
+   if (source != FPRFNone) {
+      getResultFlags(a, source);
+      a.and_(a.ppcfpscr, ~FpscrFprf);
+      a.or_(a.ppcfpscr, a.ecx);
+   }
+}
+
+// Write the FPSCR update JitFloatMode::Fast left pending, clobbers rax,
+//   rcx, rdx and xmm0.
+void
+flushFloatStatus(PPCEmuAssembler& a)
+{
+   if (!a.fpscrPending) {
+      return;
+   }
+
+   auto source = FPRFNone;
+
+   if (a.fprfPending >= 0) {
+      a.movsd(a.xmm0, a.ppcfprps[a.fprfPending][0]);
+
+      if (a.fprfPendingSingle) {
+         // Exact, the register holds a single rounded by frsp
+         a.cvtsd2ss(a.xmm0, a.xmm0);
+         source = FPRFSingle;
+      } else {
+         source = FPRFDouble;
+      }
+   }
+
+   updateFloatStatus(a, 0, source);
+   a.fpscrPending = false;
+   a.fprfPending = -1;
+}
+
+// Whether the instruction updates FPSCR itself rather than leaving it
+//   pending, record forms need it for cr1.
+static bool
+isExactFloat(PPCEmuAssembler& a, Instruction instr)
+{
+   if (a.floatMode == JitFloatMode::Exact) {
+      return true;
+   }
+
+   if (instr.rc) {
+      flushFloatStatus(a);
+      return true;
+   }
+
+   return false;
+}
+
+// Finish an instruction which sets FPSCR, and FPRF from xmm0 unless source
+//   is FPRFNone.  Exact code jumps to slowLbl for operands it leaves to
+//   the interpreter.
+static void
+finishFloatStatus(PPCEmuAssembler& a, Instruction instr, bool exact, uint32_t clear, FPRFSource source, asmjit::Label& slowLbl)
+{
+   if (!exact) {
+      a.fpscrPending = true;
+
+      if (source != FPRFNone) {
+         a.fprfPending = instr.frD;
+         a.fprfPendingSingle = source == FPRFSingle;
+      }
+
+      return;
+   }
+
+   asmjit::Label doneLbl(a);
+   updateFloatStatus(a, clear, source);
+
+   if (instr.rc) {
+      updateFloatConditionRegister(a, a.eax, a.ecx);
+   }
+
+   a.jmp(doneLbl);
+   a.bind(slowLbl);
+   jit_fallback(a, instr);
+   a.bind(doneLbl);
+}
+
+// For instructions which write frD but leave FPSCR alone
+static void
+prepareFloatMove(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc || a.fprfPending == static_cast<int>(instr.frD)) {
+      flushFloatStatus(a);
+   }
+}
+
+// cr1 = fpscr[fx, fex, vx, ox]
 void
 updateFloatConditionRegister(PPCEmuAssembler& a, const asmjit::X86GpReg& tmp, const asmjit::X86GpReg& tmp2)
 {
-   //state->cr.cr1 = state->fpscr.cr1;
-   assert(0);
+   a.mov(tmp.r32(), a.ppcfpscr);
+   a.shr(tmp.r32(), 28);
+   a.shl(tmp.r32(), 24);
+   a.mov(tmp2.r32(), a.ppccr);
+   a.and_(tmp2.r32(), ~(0xF << 24));
+   a.or_(tmp2.r32(), tmp.r32());
+   a.mov(a.ppccr, tmp2.r32());
+}
+
+// Floating Arithmetic
+enum FPArithOperator
+{
+   FPAdd,
+   FPSub,
+   FPMul,
+   FPDiv,
+};
+
+template<FPArithOperator op>
+static bool
+fpArithGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   auto exact = isExactFloat(a, instr);
+   auto frB = op == FPMul ? instr.frC : instr.frB;
+   asmjit::Label slowLbl(a);
+
+   if (exact) {
+      a.mov(a.zdx, SpecialDoubleLimit);
+      jumpIfSpecial(a, instr.frA, slowLbl);
+      jumpIfSpecial(a, frB, slowLbl);
+   }
+
+   a.movsd(a.xmm0, a.ppcfprps[instr.frA][0]);
+
+   switch (op) {
+   case FPAdd:
+      a.addsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+      break;
+   case FPSub:
+      a.subsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+      break;
+   case FPMul:
+      a.mulsd(a.xmm0, a.ppcfprps[instr.frC][0]);
+      break;
+   case FPDiv:
+      a.divsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+      break;
+   }
+
+   a.movsd(a.ppcfprps[instr.frD][0], a.xmm0);
+
+   // The invalid operation bits each one assigns
+   uint32_t clear = FpscrVXSNAN;
+
+   switch (op) {
+   case FPAdd:
+   case FPSub:
+      clear |= FpscrVXISI;
+      break;
+   case FPMul:
+      clear |= FpscrVXIMZ;
+      break;
+   case FPDiv:
+      clear |= FpscrVXZDZ | FpscrVXIDI;
+      break;
+   }
+
+   finishFloatStatus(a, instr, exact, clear, FPRFDouble, slowLbl);
+   return true;
+}
+
+// Floating Add
+static bool
+fadd(PPCEmuAssembler& a, Instruction instr)
+{
+   return fpArithGeneric<FPAdd>(a, instr);
+}
+
+// Floating Add Single
+static bool
+fadds(PPCEmuAssembler& a, Instruction instr)
+{
+   return fpArithGeneric<FPAdd>(a, instr);
+}
+
+// Floating Divide
+static bool
+fdiv(PPCEmuAssembler& a, Instruction instr)
+{
+   return fpArithGeneric<FPDiv>(a, instr);
+}
+
+// Floating Divide Single
+static bool
+fdivs(PPCEmuAssembler& a, Instruction instr)
+{
+   return fpArithGeneric<FPDiv>(a, instr);
+}
+
+// Floating Multiply
+static bool
+fmul(PPCEmuAssembler& a, Instruction instr)
+{
+   return fpArithGeneric<FPMul>(a, instr);
+}
+
+// Floating Multiply Single
+static bool
+fmuls(PPCEmuAssembler& a, Instruction instr)
+{
+   return fpArithGeneric<FPMul>(a, instr);
+}
+
+// Floating Subtract
+static bool
+fsub(PPCEmuAssembler& a, Instruction instr)
+{
+   return fpArithGeneric<FPSub>(a, instr);
+}
+
+// Floating Subtract Single
+static bool
+fsubs(PPCEmuAssembler& a, Instruction instr)
+{
+   return fpArithGeneric<FPSub>(a, instr);
+}
+
+// Load the double constant value into xmm, clobbers rax
+void
+loadConstant(PPCEmuAssembler& a, const asmjit::X86XmmReg& xmm, double value)
+{
+   a.mov(a.zax, bit_cast<uint64_t>(value));
+   a.movq(xmm, a.zax);
+}
+
+// Floating Reciprocal Estimate Single
+static bool
+fres(PPCEmuAssembler& a, Instruction instr)
+{
+   auto exact = isExactFloat(a, instr);
+   asmjit::Label slowLbl(a);
+
+   if (exact) {
+      a.mov(a.zdx, SpecialDoubleLimit);
+      jumpIfSpecial(a, instr.frB, slowLbl);
+   }
+
+   loadConstant(a, a.xmm0, 1.0);
+   a.divsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+   a.movsd(a.ppcfprps[instr.frD][0], a.xmm0);
+   finishFloatStatus(a, instr, exact, 0, FPRFDouble, slowLbl);
+   return true;
+}
+
+// Floating Reciprocal Square Root Estimate
+static bool
+frsqrte(PPCEmuAssembler& a, Instruction instr)
+{
+   auto exact = isExactFloat(a, instr);
+   asmjit::Label slowLbl(a);
+
+   if (exact) {
+      a.mov(a.zdx, SpecialDoubleLimit);
+      jumpIfSpecial(a, instr.frB, slowLbl);
+   }
+
+   a.sqrtsd(a.xmm1, a.ppcfprps[instr.frB][0]);
+   loadConstant(a, a.xmm0, 1.0);
+   a.divsd(a.xmm0, a.xmm1);
+   a.movsd(a.ppcfprps[instr.frD][0], a.xmm0);
+   finishFloatStatus(a, instr, exact, 0, FPRFDouble, slowLbl);
+   return true;
+}
+
+// Floating Select
+static bool
+fsel(PPCEmuAssembler& a, Instruction instr)
+{
+   prepareFloatMove(a, instr);
+
+   // d = (a >= 0.0) ? c : b, unordered sets CF so NaN selects b
+   a.movsd(a.xmm0, a.ppcfprps[instr.frA][0]);
+   a.xorpd(a.xmm1, a.xmm1);
+   a.mov(a.zax, a.ppcfprps[instr.frC][0]);
+   a.ucomisd(a.xmm0, a.xmm1);
+   a.cmovb(a.zax, a.ppcfprps[instr.frB][0]);
+   a.mov(a.ppcfprps[instr.frD][0], a.zax);
+
+   if (instr.rc) {
+      updateFloatConditionRegister(a, a.eax, a.ecx);
+   }
+
+   return true;
+}
+
+// Fused multiply-add instructions
+enum FMAFlags
+{
+   FMASubtract = 1 << 0, // d = a * c - b
+   FMANegate = 1 << 1, // d = -d
+};
+
+template<unsigned flags = 0>
+static bool
+fmaGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   auto exact = isExactFloat(a, instr);
+   asmjit::Label slowLbl(a);
+
+   if (exact) {
+      a.mov(a.zdx, SpecialDoubleLimit);
+      jumpIfSpecial(a, instr.frA, slowLbl);
+      jumpIfSpecial(a, instr.frB, slowLbl);
+      jumpIfSpecial(a, instr.frC, slowLbl);
+   }
+
+   a.movsd(a.xmm0, a.ppcfprps[instr.frA][0]);
+   a.mulsd(a.xmm0, a.ppcfprps[instr.frC][0]);
+
+   if (exact) {
+      // vxisi and vximz also depend on the product overflowing
+      a.movq(a.zax, a.xmm0);
+      jumpIfSpecial(a, slowLbl);
+   }
+
+   if (flags & FMASubtract) {
+      a.subsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+   } else {
+      a.addsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+   }
+
+   if (flags & FMANegate) {
+      a.movq(a.zax, a.xmm0);
+      a.btc(a.zax, 63);
+      a.movq(a.xmm0, a.zax);
+   }
+
+   a.movsd(a.ppcfprps[instr.frD][0], a.xmm0);
+   finishFloatStatus(a, instr, exact, FpscrVXSNAN | FpscrVXISI | FpscrVXIMZ, FPRFDouble, slowLbl);
+   return true;
+}
+
+// Floating Multiply-Add
+static bool
+fmadd(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric(a, instr);
+}
+
+// Floating Multiply-Add Single
+static bool
+fmadds(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric(a, instr);
+}
+
+// Floating Multiply-Sub
+static bool
+fmsub(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<FMASubtract>(a, instr);
+}
+
+// Floating Multiply-Sub Single
+static bool
+fmsubs(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<FMASubtract>(a, instr);
+}
+
+// Floating Negative Multiply-Add
+static bool
+fnmadd(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<FMANegate>(a, instr);
+}
+
+// Floating Negative Multiply-Add Single
+static bool
+fnmadds(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<FMANegate>(a, instr);
+}
+
+// Floating Negative Multiply-Sub
+static bool
+fnmsub(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<FMASubtract | FMANegate>(a, instr);
+}
+
+// Floating Negative Multiply-Sub Single
+static bool
+fnmsubs(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<FMASubtract | FMANegate>(a, instr);
+}
+
+// Floating Convert to Integer Word with Round toward Zero
+static bool
+fctiwz(PPCEmuAssembler& a, Instruction instr)
+{
+   auto exact = isExactFloat(a, instr);
+   asmjit::Label slowLbl(a);
+
+   if (!exact) {
+      prepareFloatMove(a, instr);
+   }
+
+   // cvttsd2si gives 0x80000000 for NaN and out of range values, which
+   //   is only right for negative overflow.  Exact code leaves all of
+   //   them to the interpreter as they set vxcvi.
+   a.movsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+   a.cvttsd2si(a.eax, a.xmm0);
+
+   if (exact) {
+      a.cmp(a.eax, 0x80000000);
+      a.je(slowLbl);
+   } else {
+      loadConstant(a, a.xmm1, static_cast<double>(0x7FFFFFFF));
+      a.mov(a.ecx, 0x7FFFFFFF);
+      a.ucomisd(a.xmm0, a.xmm1);
+      a.cmova(a.eax, a.ecx);
+   }
+
+   a.mov(a.ppcfpriw[instr.frD], a.eax);
+   finishFloatStatus(a, instr, exact, 0, FPRFNone, slowLbl);
+   return true;
+}
+
+// Floating Round to Single
+static bool
+frsp(PPCEmuAssembler& a, Instruction instr)
+{
+   auto exact = isExactFloat(a, instr);
+   asmjit::Label slowLbl(a);
+
+   if (exact) {
+      a.mov(a.zdx, SpecialDoubleLimit);
+      jumpIfSpecial(a, instr.frB, slowLbl);
+   }
+
+   // FPRF is set from the single
+   a.cvtsd2ss(a.xmm0, a.ppcfprps[instr.frB][0]);
+   a.cvtss2sd(a.xmm1, a.xmm0);
+   a.movsd(a.ppcfprps[instr.frD][0], a.xmm1);
+   finishFloatStatus(a, instr, exact, 0, FPRFSingle, slowLbl);
+   return true;
+}
+
+// Sign bit operations
+enum FPSignOperator
+{
+   FPSignClear, // fabs
+   FPSignSet, // fnabs
+   FPSignFlip, // fneg
+   FPSignKeep, // fmr
+};
+
+template<FPSignOperator op>
+static bool
+fpSignGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   // These never touch FPSCR, record forms only copy it to cr1
+   prepareFloatMove(a, instr);
+   a.mov(a.zax, a.ppcfprps[instr.frB][0]);
+
+   switch (op) {
+   case FPSignClear:
+      a.btr(a.zax, 63);
+      break;
+   case FPSignSet:
+      a.bts(a.zax, 63);
+      break;
+   case FPSignFlip:
+      a.btc(a.zax, 63);
+      break;
+   case FPSignKeep:
+      break;
+   }
+
+   a.mov(a.ppcfprps[instr.frD][0], a.zax);
+
+   if (instr.rc) {
+      updateFloatConditionRegister(a, a.eax, a.ecx);
+   }
+
+   return true;
+}
+
+// Floating Absolute Value
+static bool
+fabs(PPCEmuAssembler& a, Instruction instr)
+{
+   return fpSignGeneric<FPSignClear>(a, instr);
+}
+
+// Floating Negative Absolute Value
+static bool
+fnabs(PPCEmuAssembler& a, Instruction instr)
+{
+   return fpSignGeneric<FPSignSet>(a, instr);
+}
+
+// Floating Move Register
+static bool
+fmr(PPCEmuAssembler& a, Instruction instr)
+{
+   return fpSignGeneric<FPSignKeep>(a, instr);
+}
+
+// Floating Negate
+static bool
+fneg(PPCEmuAssembler& a, Instruction instr)
+{
+   return fpSignGeneric<FPSignFlip>(a, instr);
+}
+
+// Scalar float instructions with native code here, which leave their FPSCR
+//   update pending themselves in JitFloatMode::Fast.
+bool
+isNativeFloat(InstructionID id)
+{
+   switch (id) {
+   case InstructionID::fadd:
+   case InstructionID::fadds:
+   case InstructionID::fdiv:
+   case InstructionID::fdivs:
+   case InstructionID::fmul:
+   case InstructionID::fmuls:
+   case InstructionID::fsub:
+   case InstructionID::fsubs:
+   case InstructionID::fres:
+   case InstructionID::frsqrte:
+   case InstructionID::fsel:
+   case InstructionID::fmadd:
+   case InstructionID::fmadds:
+   case InstructionID::fmsub:
+   case InstructionID::fmsubs:
+   case InstructionID::fnmadd:
+   case InstructionID::fnmadds:
+   case InstructionID::fnmsub:
+   case InstructionID::fnmsubs:
+   case InstructionID::fctiwz:
+   case InstructionID::frsp:
+   case InstructionID::fabs:
+   case InstructionID::fnabs:
+   case InstructionID::fmr:
+   case InstructionID::fneg:
+      return true;
+   default:
+      return false;
+   }
 }
 
 void
 JitManager::registerFloatInstructions()
 {
-   RegisterInstructionFallback(fadd);
-   RegisterInstructionFallback(fadds);
-   RegisterInstructionFallback(fdiv);
-   RegisterInstructionFallback(fdivs);
-   RegisterInstructionFallback(fmul);
-   RegisterInstructionFallback(fmuls);
-   RegisterInstructionFallback(fsub);
-   RegisterInstructionFallback(fsubs);
-   RegisterInstructionFallback(fres);
-   RegisterInstructionFallback(frsqrte);
-   RegisterInstructionFallback(fsel);
-   RegisterInstructionFallback(fmadd);
-   RegisterInstructionFallback(fmadds);
-   RegisterInstructionFallback(fmsub);
-   RegisterInstructionFallback(fmsubs);
-   RegisterInstructionFallback(fnmadd);
-   RegisterInstructionFallback(fnmadds);
-   RegisterInstructionFallback(fnmsub);
-   RegisterInstructionFallback(fnmsubs);
+   for (auto i = 0u; i < 16; ++i) {
+      auto bits = 0u;
+      bits |= (i & 1) ? FpscrZX : 0;
+      bits |= (i & 2) ? FpscrOX : 0;
+      bits |= (i & 4) ? FpscrUX : 0;
+      bits |= (i & 8) ? FpscrFI | FpscrXX : 0;
+      sMxcsrExceptions[i] = bits;
+   }
+
+   fpscr_t check;
+   check.value = 0;
+   check.vxsnan = 1;
+   check.fx = 1;
+   assert(check.value == (FpscrVXSNAN | FpscrFX));
+
+   RegisterInstruction(fadd);
+   RegisterInstruction(fadds);
+   RegisterInstruction(fdiv);
+   RegisterInstruction(fdivs);
+   RegisterInstruction(fmul);
+   RegisterInstruction(fmuls);
+   RegisterInstruction(fsub);
+   RegisterInstruction(fsubs);
+   RegisterInstruction(fres);
+   RegisterInstruction(frsqrte);
+   RegisterInstruction(fsel);
+   RegisterInstruction(fmadd);
+   RegisterInstruction(fmadds);
+   RegisterInstruction(fmsub);
+   RegisterInstruction(fmsubs);
+   RegisterInstruction(fnmadd);
+   RegisterInstruction(fnmadds);
+   RegisterInstruction(fnmsub);
+   RegisterInstruction(fnmsubs);
    RegisterInstructionFallback(fctiw);
-   RegisterInstructionFallback(fctiwz);
-   RegisterInstructionFallback(frsp);
-   RegisterInstructionFallback(fabs);
-   RegisterInstructionFallback(fnabs);
-   RegisterInstructionFallback(fmr);
-   RegisterInstructionFallback(fabs);
-   RegisterInstructionFallback(fneg);
-}
\ No newline at end of file
+   RegisterInstruction(fctiwz);
+   RegisterInstruction(frsp);
+   RegisterInstruction(fabs);
+   RegisterInstruction(fnabs);
+   RegisterInstruction(fmr);
+   RegisterInstruction(fneg);
+}
@@ -3,40 +3,21 @@
 
 // Update cr0 with value
 static void
-updateConditionRegister(PPCEmuAssembler& a, const asmjit::X86GpReg& value, const asmjit::X86GpReg& tmp, const asmjit::X86GpReg& tmp2)
+updateConditionRegister(PPCEmuAssembler& a, const asmjit::X86GpReg& value)
 {
-   auto crtarget = 0;
-   auto crshift = (7 - crtarget) * 4;
-
-   a.mov(tmp, a.ppccr);
-   a.and_(tmp, ~(0xF << crshift));
+   if (a.cr0Dead) {
+      return;
+   }
 
    a.cmp(value, 0);
 
-   a.lahf();
-   a.mov(tmp2, 0);
-   a.sete(tmp2.r8());
-   a.shl(tmp2, crshift + ConditionRegisterFlag::ZeroShift);
-   a.or_(tmp, tmp2);
-
-   a.sahf();
-   a.mov(tmp2, 0);
-   a.setg(tmp2.r8());
-   a.shl(tmp2, crshift + ConditionRegisterFlag::PositiveShift);
-   a.or_(tmp, tmp2);
-
-   a.sahf();
-   a.mov(tmp2, 0);
-   a.setl(tmp2.r8());
-   a.shl(tmp2, crshift + ConditionRegisterFlag::NegativeShift);
-   a.or_(tmp, tmp2);
-
-   a.mov(tmp2, a.ppcxer);
-   a.and_(tmp2, XERegisterBits::StickyOV);
-   a.shiftTo(tmp2, XERegisterBits::StickyOVShift, crshift + ConditionRegisterFlag::SummaryOverflowShift);
-   a.or_(tmp, tmp2);
-
-   a.mov(a.ppccr, tmp);
+   if (a.crFuseField == 0) {
+      // The following bc will use the host flags directly
+      a.pendingCrField = 0;
+      a.pendingCrUnsigned = false;
+   } else {
+      setCRFFromFlags(a, 0, false);
+   }
 }
 
 // Add
@@ -65,7 +46,7 @@ addGeneric(PPCEmuAssembler& a, Instruction instr)
    bool recordCarry = false;
    bool recordOverflow = false;
    bool recordCond = false;
-   if (flags & AddCarry) {
+   if ((flags & AddCarry) && !a.carryDead) {
       recordCarry = true;
    }
    if (flags & AddAlwaysRecord) {
@@ -80,10 +61,22 @@ addGeneric(PPCEmuAssembler& a, Instruction instr)
       }
    }
 
-   if ((flags & AddZeroRA) && instr.rA == 0) {
+   // li, lis and addi/addis on a known register
+   auto raZero = (flags & AddZeroRA) && instr.rA == 0;
+   if ((flags & AddImmediate) && !recordCarry && !recordOverflow && !recordCond
+       && (raZero || a.isGprKnown(instr.rA))) {
+      auto value = raZero ? 0u : a.knownGprValues[instr.rA];
+      auto imm = sign_extend<16, uint32_t>(instr.simm);
+      value += (flags & AddShifted) ? (imm << 16) : imm;
+      a.mov(a.eax, value);
+      a.storeGpr(instr.rD, a.eax);
+      return true;
+   }
+
+   if (raZero) {
       a.mov(a.eax, 0);
    } else {
-      a.mov(a.eax, a.ppcgpr[instr.rA]);
+      a.loadGpr(a.eax, instr.rA);
    }
 
    if (flags & AddSubtract) {
@@ -97,7 +90,7 @@ addGeneric(PPCEmuAssembler& a, Instruction instr)
    } else if (flags & AddToMinusOne) {
       a.mov(a.ecx, -1);
    } else {
-      a.mov(a.ecx, a.ppcgpr[instr.rB]);
+      a.loadGpr(a.ecx, instr.rB);
    }
 
    if (flags & AddShifted) {
@@ -153,10 +146,10 @@ addGeneric(PPCEmuAssembler& a, Instruction instr)
       a.mov(a.ppcxer, a.edx);
    }
 
-   a.mov(a.ppcgpr[instr.rD], a.eax);
+   a.storeGpr(instr.rD, a.eax);
 
    if (recordCond) {
-      updateConditionRegister(a, a.eax, a.ecx, a.edx);
+      updateConditionRegister(a, a.eax);
    }
 
    return true;
@@ -230,31 +223,35 @@ template<unsigned flags>
 static bool
 andGeneric(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rS]);
+   a.loadGpr(a.eax, instr.rS);
 
    if (flags & AndImmediate) {
       a.mov(a.ecx, instr.uimm);
    } else {
-      a.mov(a.ecx, a.ppcgpr[instr.rB]);
+      a.loadGpr(a.ecx, instr.rB);
    }
    
    if (flags & AndShifted) {
       a.shl(a.ecx, 16);
    }
 
-   if (flags & AndComplement) {
-      a.not_(a.ecx);
-   }
+   if ((flags & AndComplement) && (a.cpuFeatures & JitCpuBmi1)) {
+      a.andn(a.eax, a.ecx, a.eax);
+   } else {
+      if (flags & AndComplement) {
+         a.not_(a.ecx);
+      }
 
-   a.and_(a.eax, a.ecx);
+      a.and_(a.eax, a.ecx);
+   }
 
-   a.mov(a.ppcgpr[instr.rA], a.eax);
+   a.storeGpr(instr.rA, a.eax);
 
    if (flags & AndAlwaysRecord) {
-      updateConditionRegister(a, a.eax, a.ecx, a.edx);
+      updateConditionRegister(a, a.eax);
    } else if (flags & AndCheckRecord) {
       if (instr.rc) {
-         updateConditionRegister(a, a.eax, a.ecx, a.edx);
+         updateConditionRegister(a, a.eax);
       }
    }
 
@@ -291,7 +288,20 @@ cntlzw(PPCEmuAssembler& a, Instruction instr)
 {
    asmjit::Label lblZero(a);
 
-   a.mov(a.ecx, a.ppcgpr[instr.rS]);
+   if (a.cpuFeatures & JitCpuLzcnt) {
+      // lzcnt already gives 32 for zero
+      a.loadGpr(a.ecx, instr.rS);
+      a.lzcnt(a.eax, a.ecx);
+      a.storeGpr(instr.rA, a.eax);
+
+      if (instr.rc) {
+         updateConditionRegister(a, a.eax);
+      }
+
+      return true;
+   }
+
+   a.loadGpr(a.ecx, instr.rS);
    a.mov(a.eax, 32);
 
    a.cmp(a.ecx, 0);
@@ -304,10 +314,10 @@ cntlzw(PPCEmuAssembler& a, Instruction instr)
    a.sub(a.eax, a.edx);
    
    a.bind(lblZero);
-   a.mov(a.ppcgpr[instr.rA], a.eax);
+   a.storeGpr(instr.rA, a.eax);
 
    if (instr.rc) {
-      updateConditionRegister(a, a.eax, a.ecx, a.edx);
+      updateConditionRegister(a, a.eax);
    }
 
    return true;
@@ -338,16 +348,16 @@ divwu(PPCEmuAssembler& a, Instruction instr)
 static bool
 eqv(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rS]);
-   a.mov(a.ecx, a.ppcgpr[instr.rB]);
+   a.loadGpr(a.eax, instr.rS);
+   a.loadGpr(a.ecx, instr.rB);
    
    a.xor_(a.eax, a.ecx);
    a.not_(a.eax);
 
-   a.mov(a.ppcgpr[instr.rA], a.eax);
+   a.storeGpr(instr.rA, a.eax);
 
    if (instr.rc) {
-      updateConditionRegister(a, a.eax, a.ecx, a.edx);
+      updateConditionRegister(a, a.eax);
    }
 
    return true;
@@ -357,14 +367,14 @@ eqv(PPCEmuAssembler& a, Instruction instr)
 static bool
 extsb(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rS]);
+   a.loadGpr(a.eax, instr.rS);
 
    a.movsx(a.eax, a.eax.r8());
 
-   a.mov(a.ppcgpr[instr.rA], a.eax);
+   a.storeGpr(instr.rA, a.eax);
 
    if (instr.rc) {
-      updateConditionRegister(a, a.eax, a.ecx, a.edx);
+      updateConditionRegister(a, a.eax);
    }
 
    return true;
@@ -374,14 +384,14 @@ extsb(PPCEmuAssembler& a, Instruction instr)
 static bool
 extsh(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rS]);
+   a.loadGpr(a.eax, instr.rS);
 
    a.movsx(a.eax, a.eax.r16());
 
-   a.mov(a.ppcgpr[instr.rA], a.eax);
+   a.storeGpr(instr.rA, a.eax);
 
    if (instr.rc) {
-      updateConditionRegister(a, a.eax, a.ecx, a.edx);
+      updateConditionRegister(a, a.eax);
    }
 
    return true;
@@ -401,30 +411,30 @@ template<unsigned flags>
 static bool
 mulSignedGeneric(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rA]);
+   a.loadGpr(a.eax, instr.rA);
 
    if (flags & MulImmediate) {
       a.mov(a.ecx, sign_extend<16>(instr.simm));
    } else {
-      a.mov(a.ecx, a.ppcgpr[instr.rB]);
+      a.loadGpr(a.ecx, instr.rB);
    }
 
    a.imul(a.ecx);
 
    if (flags & MulLow) {
-      a.mov(a.ppcgpr[instr.rD], a.eax);
+      a.storeGpr(instr.rD, a.eax);
 
       if (flags & MulCheckRecord) {
          if (instr.rc) {
-            updateConditionRegister(a, a.eax, a.ecx, a.edx);
+            updateConditionRegister(a, a.eax);
          }
       }
    } else if (flags & MulHigh) {
-      a.mov(a.ppcgpr[instr.rD], a.edx);
+      a.storeGpr(instr.rD, a.edx);
 
       if (flags & MulCheckRecord) {
          if (instr.rc) {
-            updateConditionRegister(a, a.edx, a.ecx, a.eax);
+            updateConditionRegister(a, a.edx);
          }
       }
    } else {
@@ -439,30 +449,30 @@ template<unsigned flags>
 static bool
 mulUnsignedGeneric(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rA]);
+   a.loadGpr(a.eax, instr.rA);
 
    if (flags & MulImmediate) {
       a.mov(a.ecx, sign_extend<16>(instr.simm));
    } else {
-      a.mov(a.ecx, a.ppcgpr[instr.rB]);
+      a.loadGpr(a.ecx, instr.rB);
    }
 
    a.mul(a.ecx);
 
    if (flags & MulLow) {
-      a.mov(a.ppcgpr[instr.rD], a.eax);
+      a.storeGpr(instr.rD, a.eax);
 
       if (flags & MulCheckRecord) {
          if (instr.rc) {
-            updateConditionRegister(a, a.eax, a.ecx, a.edx);
+            updateConditionRegister(a, a.eax);
          }
       }
    } else if (flags & MulHigh) {
-      a.mov(a.ppcgpr[instr.rD], a.edx);
+      a.storeGpr(instr.rD, a.edx);
 
       if (flags & MulCheckRecord) {
          if (instr.rc) {
-            updateConditionRegister(a, a.edx, a.ecx, a.eax);
+            updateConditionRegister(a, a.edx);
          }
       }
    } else {
@@ -500,16 +510,16 @@ mullw(PPCEmuAssembler& a, Instruction instr)
 static bool
 nand(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rS]);
-   a.mov(a.ecx, a.ppcgpr[instr.rB]);
+   a.loadGpr(a.eax, instr.rS);
+   a.loadGpr(a.ecx, instr.rB);
 
    a.and_(a.eax, a.ecx);
    a.not_(a.eax);
 
-   a.mov(a.ppcgpr[instr.rA], a.eax);
+   a.storeGpr(instr.rA, a.eax);
 
    if (instr.rc) {
-      updateConditionRegister(a, a.eax, a.ecx, a.edx);
+      updateConditionRegister(a, a.eax);
    }
 
    return true;
@@ -519,9 +529,9 @@ nand(PPCEmuAssembler& a, Instruction instr)
 static bool
 neg(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rA]);
+   a.loadGpr(a.eax, instr.rA);
    a.neg(a.eax);
-   a.mov(a.ppcgpr[instr.rD], a.eax);
+   a.storeGpr(instr.rD, a.eax);
 
    if (instr.oe) {
       a.mov(a.ecx, 0);
@@ -540,7 +550,7 @@ neg(PPCEmuAssembler& a, Instruction instr)
    }
 
    if (instr.rc) {
-      updateConditionRegister(a, a.eax, a.ecx, a.edx);
+      updateConditionRegister(a, a.eax);
    }
 
    return true;
@@ -550,16 +560,16 @@ neg(PPCEmuAssembler& a, Instruction instr)
 static bool
 nor(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rS]);
-   a.mov(a.ecx, a.ppcgpr[instr.rB]);
+   a.loadGpr(a.eax, instr.rS);
+   a.loadGpr(a.ecx, instr.rB);
 
    a.or_(a.eax, a.ecx);
    a.not_(a.eax);
 
-   a.mov(a.ppcgpr[instr.rA], a.eax);
+   a.storeGpr(instr.rA, a.eax);
 
    if (instr.rc) {
-      updateConditionRegister(a, a.eax, a.ecx, a.edx);
+      updateConditionRegister(a, a.eax);
    }
 
    return true;
@@ -579,13 +589,22 @@ template<unsigned flags>
 static bool
 orGeneric(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rS]);
+   // ori/oris completing a lis
+   if ((flags & OrImmediate) && !(flags & OrAlwaysRecord) && a.isGprKnown(instr.rS)) {
+      auto imm = static_cast<uint32_t>(instr.uimm);
+      imm = (flags & OrShifted) ? (imm << 16) : imm;
+      a.mov(a.eax, a.knownGprValues[instr.rS] | imm);
+      a.storeGpr(instr.rA, a.eax);
+      return true;
+   }
+
+   a.loadGpr(a.eax, instr.rS);
 
    if (flags & OrImmediate) {
       a.mov(a.ecx, instr.uimm);
    }
    else {
-      a.mov(a.ecx, a.ppcgpr[instr.rB]);
+      a.loadGpr(a.ecx, instr.rB);
    }
    
    if (flags & OrShifted) {
@@ -597,14 +616,14 @@ orGeneric(PPCEmuAssembler& a, Instruction instr)
    }
 
    a.or_(a.eax, a.ecx);
-   a.mov(a.ppcgpr[instr.rA], a.eax);
+   a.storeGpr(instr.rA, a.eax);
 
    if (flags & OrAlwaysRecord) {
-      updateConditionRegister(a, a.eax, a.ecx, a.edx);
+      updateConditionRegister(a, a.eax);
    }
    else if (flags & OrCheckRecord) {
       if (instr.rc) {
-         updateConditionRegister(a, a.eax, a.ecx, a.edx);
+         updateConditionRegister(a, a.eax);
       }
    }
 
@@ -647,14 +666,18 @@ template<unsigned flags>
 static bool
 rlwGeneric(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rS]);
-
-   if (flags & RlwImmediate) {
+   if ((flags & RlwImmediate) && (a.cpuFeatures & JitCpuBmi2)) {
+      // rorx does not touch flags and leaves the source intact
+      a.loadGpr(a.ecx, instr.rS);
+      a.rorx(a.eax, a.ecx, (32 - instr.sh) & 31);
+   } else if (flags & RlwImmediate) {
+      a.loadGpr(a.eax, instr.rS);
       a.rol(a.eax, instr.sh);
    } else {
-      a.mov(a.edx, a.ppcgpr[instr.rB]);
-      a.and_(a.edx, 0x1f);
-      a.rol(a.eax, a.edx);
+      // x86 only rotates by cl, which masks the count to 0-31 itself
+      a.loadGpr(a.eax, instr.rS);
+      a.loadGpr(a.ecx, instr.rB);
+      a.rol(a.eax, a.ecx.r8());
    }
 
    auto m = make_ppc_bitmask(instr.mb, instr.me);
@@ -663,15 +686,15 @@ rlwGeneric(PPCEmuAssembler& a, Instruction instr)
       a.and_(a.eax, m);
    } else if (flags & RlwInsert) {
       a.and_(a.eax, m);
-      a.mov(a.ecx, a.ppcgpr[instr.rA]);
+      a.loadGpr(a.ecx, instr.rA);
       a.and_(a.ecx, ~m);
       a.or_(a.eax, a.ecx);
    }
 
-   a.mov(a.ppcgpr[instr.rA], a.eax);
+   a.storeGpr(instr.rA, a.eax);
 
    if (instr.rc) {
-      updateConditionRegister(a, a.eax, a.ecx, a.edx);
+      updateConditionRegister(a, a.eax);
    }
 
    return true;
@@ -710,7 +733,7 @@ template<unsigned flags>
 static bool
 shiftLogical(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rS]);
+   a.loadGpr(a.eax, instr.rS);
 
    if (flags & ShiftImmediate) {
       if (flags & ShiftLeft) {
@@ -721,7 +744,7 @@ shiftLogical(PPCEmuAssembler& a, Instruction instr)
          assert(0);
       }
    } else {
-      a.mov(a.ecx, a.ppcgpr[instr.rB]);
+      a.loadGpr(a.ecx, instr.rB);
 
       if (flags & ShiftLeft) {
          a.shl(a.eax, a.ecx.r8());
@@ -732,10 +755,10 @@ shiftLogical(PPCEmuAssembler& a, Instruction instr)
       }
    }
 
-   a.mov(a.ppcgpr[instr.rA], a.eax);
+   a.storeGpr(instr.rA, a.eax);
 
    if (instr.rc) {
-      updateConditionRegister(a, a.eax, a.ecx, a.edx);
+      updateConditionRegister(a, a.eax);
    }
 
    return true;
@@ -832,12 +855,12 @@ template<unsigned flags>
 static bool
 xorGeneric(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rS]);
+   a.loadGpr(a.eax, instr.rS);
 
    if (flags & XorImmediate) {
       a.mov(a.ecx, instr.uimm);
    } else {
-      a.mov(a.ecx, a.ppcgpr[instr.rB]);
+      a.loadGpr(a.ecx, instr.rB);
    }
 
    if (flags & XorShifted) {
@@ -845,11 +868,11 @@ xorGeneric(PPCEmuAssembler& a, Instruction instr)
    }
 
    a.xor_(a.eax, a.ecx);
-   a.mov(a.ppcgpr[instr.rA], a.eax);
+   a.storeGpr(instr.rA, a.eax);
 
    if (flags & XorCheckRecord) {
       if (instr.rc) {
-         updateConditionRegister(a, a.eax, a.ecx, a.edx);
+         updateConditionRegister(a, a.eax);
       }
    }
    
@@ -1,6 +1,203 @@
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include "bitutils.h"
 #include "jit.h"
+#include "jit_float.h"
+#include "log.h"
+
+template<size_t Size>
+struct FastmemType;
+
+template<>
+struct FastmemType<1> { typedef uint8_t type; };
+
+template<>
+struct FastmemType<2> { typedef uint16_t type; };
+
+template<>
+struct FastmemType<4> { typedef uint32_t type; };
+
+template<>
+struct FastmemType<8> { typedef uint64_t type; };
+
+// Checked accesses for fastmem sites which have faulted, values are in
+//   the same byte order as the fast path used.  Invalid accesses read as
+//   0 and drop writes, there is no guest exception vector to deliver a
+//   DSI to.
+template<typename Type, bool Swap>
+static uint64_t
+fastmemSlowRead(uint32_t address)
+{
+   if (!gMemory.valid(address) || !gMemory.valid(address + sizeof(Type) - 1)) {
+      gLog->error("Invalid {} byte guest read from {:08x}", sizeof(Type), address);
+      return 0;
+   }
+
+   if (Swap) {
+      return gMemory.read<Type>(address);
+   } else {
+      return gMemory.readNoSwap<Type>(address);
+   }
+}
+
+template<typename Type, bool Swap>
+static void
+fastmemSlowWrite(uint32_t address, uint64_t value)
+{
+   if (!gMemory.valid(address) || !gMemory.valid(address + sizeof(Type) - 1)) {
+      gLog->error("Invalid {} byte guest write to {:08x}", sizeof(Type), address);
+      return;
+   }
+
+   if (Swap) {
+      gMemory.write<Type>(address, static_cast<Type>(value));
+   } else {
+      gMemory.writeNoSwap<Type>(address, static_cast<Type>(value));
+   }
+}
+
+// Byte swap the low Size bytes of rax
+template<size_t Size>
+static void
+swapRax(PPCEmuAssembler& a)
+{
+   if (Size == 2) {
+      a.xchg(a.eax.r8Hi(), a.eax.r8Lo());
+   } else if (Size == 4) {
+      a.bswap(a.eax);
+   } else if (Size == 8) {
+      a.bswap(a.zax);
+   }
+}
+
+// Access Size bytes at the guest address in ecx through membase with no
+//   checks, loads go to rax and stores come from rax.  With swap set the
+//   value in rax is in host byte order, using movbe when the host has it.
+//   The site is recorded so a host fault on it continues in a checked slow
+//   path, see JitManager::handleAccessFault.
+template<size_t Size, bool Write>
+static void
+fastmemAccess(PPCEmuAssembler& a, bool swap)
+{
+   typedef typename FastmemType<Size>::type Type;
+   PPCEmuAssembler::FastmemSite site(a);
+   auto movbe = swap && Size > 1 && (a.cpuFeatures & JitCpuMovbe);
+   site.cia = a.genCia;
+   site.write = Write;
+
+   if (Write) {
+      if (movbe) {
+         site.slowFn = reinterpret_cast<const void *>(&fastmemSlowWrite<Type, true>);
+      } else {
+         site.slowFn = reinterpret_cast<const void *>(&fastmemSlowWrite<Type, false>);
+      }
+   } else {
+      if (movbe) {
+         site.slowFn = reinterpret_cast<const void *>(&fastmemSlowRead<Type, true>);
+      } else {
+         site.slowFn = reinterpret_cast<const void *>(&fastmemSlowRead<Type, false>);
+      }
+   }
+
+   if (Write && swap && !movbe) {
+      swapRax<Size>(a);
+   }
+
+   // start is one 5 byte nop which handleAccessFault replaces with a jmp
+   //   to the slow path in a single 8 byte store, so it may not cross an
+   //   8 byte boundary.  Generated code is allocated 8 byte aligned.
+   while ((a.getOffset() & 7) > 3) {
+      a.nop();
+   }
+
+   static const uint8_t nop5[] = { 0x0F, 0x1F, 0x44, 0x00, 0x00 };
+   a.bind(site.start);
+   a.embed(nop5, sizeof(nop5));
+   a.mov(a.zdx, a.zcx);
+   a.add(a.zdx, a.membase);
+   a.bind(site.access);
+
+   if (movbe) {
+      if (Write) {
+         if (Size == 2) {
+            a.movbe(asmjit::X86Mem(a.zdx, 0), a.eax.r16());
+         } else if (Size == 4) {
+            a.movbe(asmjit::X86Mem(a.zdx, 0), a.eax);
+         } else {
+            a.movbe(asmjit::X86Mem(a.zdx, 0), a.zax);
+         }
+      } else {
+         if (Size == 2) {
+            a.movbe(a.eax.r16(), asmjit::X86Mem(a.zdx, 0));
+         } else if (Size == 4) {
+            a.movbe(a.eax, asmjit::X86Mem(a.zdx, 0));
+         } else {
+            a.movbe(a.zax, asmjit::X86Mem(a.zdx, 0));
+         }
+      }
+   } else if (Write) {
+      if (Size == 1) {
+         a.mov(asmjit::X86Mem(a.zdx, 0), a.eax.r8());
+      } else if (Size == 2) {
+         a.mov(asmjit::X86Mem(a.zdx, 0), a.eax.r16());
+      } else if (Size == 4) {
+         a.mov(asmjit::X86Mem(a.zdx, 0), a.eax);
+      } else {
+         a.mov(asmjit::X86Mem(a.zdx, 0), a.zax);
+      }
+   } else {
+      if (Size == 1) {
+         a.mov(a.eax.r8(), asmjit::X86Mem(a.zdx, 0));
+      } else if (Size == 2) {
+         a.mov(a.eax.r16(), asmjit::X86Mem(a.zdx, 0));
+      } else if (Size == 4) {
+         a.mov(a.eax, asmjit::X86Mem(a.zdx, 0));
+      } else {
+         a.mov(a.zax, asmjit::X86Mem(a.zdx, 0));
+      }
+   }
+
+   a.bind(site.resume);
+   a.fastmemSites.push_back(site);
+
+   if (!Write && swap && !movbe) {
+      swapRax<Size>(a);
+   }
+}
+
+// ecx = (rA|0) + d, or (rA|0) + rB when indexed.  Folded to a constant
+//   when the registers involved are known.
+static void
+loadEffectiveAddress(PPCEmuAssembler& a, Instruction instr, bool indexed, bool zeroRA)
+{
+   auto raZero = zeroRA && instr.rA == 0;
+   auto raKnown = raZero || a.isGprKnown(instr.rA);
+   auto ra = raZero ? 0u : a.knownGprValues[instr.rA];
+
+   if (indexed) {
+      if (raKnown && a.isGprKnown(instr.rB)) {
+         a.mov(a.ecx, ra + a.knownGprValues[instr.rB]);
+      } else if (raZero) {
+         a.loadGpr(a.ecx, instr.rB);
+      } else {
+         a.loadGpr(a.ecx, instr.rA);
+         a.addGpr(a.ecx, instr.rB);
+      }
+   } else {
+      auto d = sign_extend<16, uint32_t>(instr.d);
+
+      if (raKnown) {
+         a.mov(a.ecx, ra + d);
+      } else {
+         a.loadGpr(a.ecx, instr.rA);
+
+         if (d != 0) {
+            a.add(a.ecx, static_cast<int32_t>(d));
+         }
+      }
+   }
+}
 
 // Load
 enum LoadFlags
@@ -17,48 +214,14 @@ template<typename Type, unsigned flags = 0>
 static bool
 loadGeneric(PPCEmuAssembler& a, Instruction instr)
 {
-   if ((flags & LoadZeroRA) && instr.rA == 0) {
-      a.mov(a.ecx, 0u);
-   }
-   else {
-      a.mov(a.ecx, a.ppcgpr[instr.rA]);
-   }
+   loadEffectiveAddress(a, instr, !!(flags & LoadIndexed), !!(flags & LoadZeroRA));
 
-   if (flags & LoadIndexed) {
-      a.add(a.ecx, a.ppcgpr[instr.rB]);
-   }
-   else {
-      auto x = sign_extend<16, int32_t>(instr.d);
-      if (x != 0) {
-         a.add(a.ecx, x);
-      }
-   }
-
-   a.mov(a.zdx, a.zcx);
-   a.add(a.zdx, a.membase);
-   if (sizeof(Type) == 1) {
-      a.mov(a.eax, 0);
-      a.mov(a.eax.r8(), asmjit::X86Mem(a.zdx, 0));
-   } else if (sizeof(Type) == 2) {
+   if (sizeof(Type) < 4) {
       a.mov(a.eax, 0);
-      a.mov(a.eax.r16(), asmjit::X86Mem(a.zdx, 0));
-      if (!(flags & LoadByteReverse)) {
-         a.xchg(a.eax.r8Hi(), a.eax.r8Lo());
-      }
-   } else if (sizeof(Type) == 4) {
-      a.mov(a.eax, asmjit::X86Mem(a.zdx, 0));
-      if (!(flags & LoadByteReverse)) {
-         a.bswap(a.eax);
-      }
-   } else if (sizeof(Type) == 8) {
-      a.mov(a.zax, asmjit::X86Mem(a.zdx, 0));
-      if (!(flags & LoadByteReverse)) {
-         a.bswap(a.zax);
-      }
-   } else {
-      assert(0);
    }
 
+   fastmemAccess<sizeof(Type), false>(a, !(flags & LoadByteReverse));
+
    if (std::is_floating_point<Type>::value) {
       if (sizeof(Type) == 4) {
          a.movq(a.xmm0, a.zax);
@@ -75,21 +238,18 @@ loadGeneric(PPCEmuAssembler& a, Instruction instr)
          a.movsx(a.eax, a.eax.r16());
       }
 
-      a.mov(a.ppcgpr[instr.rD], a.eax);
+      a.storeGpr(instr.rD, a.eax);
    }
 
    if (flags & LoadReserve) {
+      // eax still holds the word just loaded
       a.mov(a.ppcreserve, 1u);
       a.mov(a.ppcreserveAddress, a.ecx);
-      a.mov(a.zdx, a.ecx);
-      a.add(a.zdx, a.membase);
-      a.mov(a.eax, asmjit::X86Mem(a.zdx, 0));
-      a.bswap(a.eax);
       a.mov(a.ppcreserveData, a.eax);
    }
 
    if (flags & LoadUpdate) {
-      a.mov(a.ppcgpr[instr.rA], a.ecx);
+      a.storeGpr(instr.rA, a.ecx);
    }
    return true;
 }
@@ -263,7 +423,7 @@ lmw(PPCEmuAssembler& a, Instruction instr)
 {
    auto o = sign_extend<16, int32_t>(instr.d);
    if (instr.rA) {
-      a.mov(a.ecx, a.ppcgpr[instr.rA]);
+      a.loadGpr(a.ecx, instr.rA);
       if (o != 0) {
          a.add(a.ecx, o);
       }
@@ -271,12 +431,14 @@ lmw(PPCEmuAssembler& a, Instruction instr)
    else {
       a.mov(a.ecx, o);
    }
-   a.add(a.zcx, a.membase);
 
-   for (int r = instr.rD, d = 0; r <= 31; ++r, d += 4) {
-      a.mov(a.eax, asmjit::X86Mem(a.zcx, d));
-      a.bswap(a.eax);
-      a.mov(a.ppcgpr[r], a.eax);
+   for (int r = instr.rD; r <= 31; ++r) {
+      fastmemAccess<4, false>(a, true);
+      a.storeGpr(r, a.eax);
+
+      if (r < 31) {
+         a.add(a.ecx, 4);
+      }
    }
    return true;
 }
@@ -326,24 +488,7 @@ storeGeneric(PPCEmuAssembler& a, Instruction instr)
       return jit_fallback(a, instr);
    }
 
-   if ((flags & StoreZeroRA) && instr.rA == 0) {
-      if (flags & StoreIndexed) {
-         a.mov(a.ecx, a.ppcgpr[instr.rB]);
-      } else {
-         a.mov(a.ecx, sign_extend<16, int32_t>(instr.d));
-      }
-   } else {
-      a.mov(a.ecx, a.ppcgpr[instr.rA]);
-
-      if (flags & StoreIndexed) {
-         a.add(a.ecx, a.ppcgpr[instr.rB]);
-      } else {
-         auto x = sign_extend<16, int32_t>(instr.d);
-         if (x != 0) {
-            a.add(a.ecx, x);
-         }
-      }
-   }
+   loadEffectiveAddress(a, instr, !!(flags & StoreIndexed), !!(flags & StoreZeroRA));
 
    if (flags & StoreConditional) {
       /*
@@ -360,9 +505,6 @@ storeGeneric(PPCEmuAssembler& a, Instruction instr)
       */
    }
 
-   a.mov(a.zdx, a.zcx);
-   a.add(a.zdx, a.membase);
-
    if (flags & StoreFloatAsInteger) {
       assert(sizeof(Type) == 4);
       a.mov(a.eax, a.ppcfprps[instr.rS][0]);
@@ -377,45 +519,20 @@ storeGeneric(PPCEmuAssembler& a, Instruction instr)
       }
    } else {
       if (sizeof(Type) == 1) {
-         a.mov(a.eax.r8(), a.ppcgpr[instr.rS]);
+         a.loadGpr(a.eax, instr.rS);
       } else if (sizeof(Type) == 2) {
-         a.mov(a.eax.r16(), a.ppcgpr[instr.rS]);
+         a.loadGpr(a.eax, instr.rS);
       } else if (sizeof(Type) == 4) {
-         a.mov(a.eax, a.ppcgpr[instr.rS]);
+         a.loadGpr(a.eax, instr.rS);
       } else {
          assert(0);
       }
    }
 
-   if (!(flags & StoreByteReverse)) {
-      if (sizeof(Type) == 1) {
-         // Inverted reverse logic means we have
-         //    to check for this but do nothing.
-      } else if (sizeof(Type) == 2) {
-         a.xchg(a.eax.r8Hi(), a.eax.r8Lo());
-      } else if (sizeof(Type) == 4) {
-         a.bswap(a.eax);
-      } else if (sizeof(Type) == 8) {
-         a.bswap(a.zax);
-      } else {
-         assert(0);
-      }
-   }
-
-   if (sizeof(Type) == 1) {
-      a.mov(asmjit::X86Mem(a.zdx, 0), a.eax.r8());
-   } else if (sizeof(Type) == 2) {
-      a.mov(asmjit::X86Mem(a.zdx, 0), a.eax.r16());
-   } else if (sizeof(Type) == 4) {
-      a.mov(asmjit::X86Mem(a.zdx, 0), a.eax);
-   } else if (sizeof(Type) == 8) {
-      a.mov(asmjit::X86Mem(a.zdx, 0), a.zax);
-   } else {
-      assert(0);
-   }
+   fastmemAccess<sizeof(Type), true>(a, !(flags & StoreByteReverse));
 
    if (flags & StoreUpdate) {
-      a.mov(a.ppcgpr[instr.rA], a.ecx);
+      a.storeGpr(instr.rA, a.ecx);
    }
 
    return true;
@@ -572,19 +689,21 @@ stmw(PPCEmuAssembler& a, Instruction instr)
 {
    auto o = sign_extend<16, int32_t>(instr.d);
    if (instr.rA) {
-      a.mov(a.ecx, a.ppcgpr[instr.rA]);
+      a.loadGpr(a.ecx, instr.rA);
       if (o != 0) {
          a.add(a.ecx, o);
       }
    } else {
       a.mov(a.ecx, o);
    }
-   a.add(a.zcx, a.membase);
-   
-   for (int r = instr.rS, d = 0; r <= 31; ++r, d += 4) {
-      a.mov(a.eax, a.ppcgpr[r]);
-      a.bswap(a.eax);
-      a.mov(asmjit::X86Mem(a.zcx, d), a.eax);
+
+   for (int r = instr.rS; r <= 31; ++r) {
+      a.loadGpr(a.eax, r);
+      fastmemAccess<4, true>(a, true);
+
+      if (r < 31) {
+         a.add(a.ecx, 4);
+      }
    }
    return true;
 }
@@ -622,11 +741,143 @@ enum PsqLoadFlags
    PsqLoadIndexed = 1 << 2,
 };
 
+// Element size in bytes of a quantized type
+static int32_t
+getQuantizedSize(QuantizedDataType type)
+{
+   switch (type) {
+   case QuantizedDataType::Floating:
+      return 4;
+   case QuantizedDataType::Unsigned8:
+   case QuantizedDataType::Signed8:
+      return 1;
+   case QuantizedDataType::Unsigned16:
+   case QuantizedDataType::Signed16:
+      return 2;
+   default:
+      return 0;
+   }
+}
+
+// Scale applied when loading, 2^-scale with scale as a signed 6 bit value
+static double
+getDequantizeScale(uint32_t scale)
+{
+   return std::ldexp(1.0, scale < 32 ? -static_cast<int>(scale) : 64 - static_cast<int>(scale));
+}
+
+// ecx = ea
+template<unsigned zeroRA, unsigned indexed>
+static void
+calculatePsqAddress(PPCEmuAssembler& a, Instruction instr)
+{
+   if (zeroRA && instr.rA == 0) {
+      a.mov(a.ecx, 0u);
+   } else {
+      a.loadGpr(a.ecx, instr.rA);
+   }
+
+   if (indexed) {
+      a.addGpr(a.ecx, instr.rB);
+   } else {
+      auto x = sign_extend<12, int32_t>(instr.qd);
+      if (x != 0) {
+         a.add(a.ecx, x);
+      }
+   }
+}
+
+// Load one quantized element at the guest address in ecx into dst.  The
+//   access may call a slow path, so the scale is only loaded after it.
+static void
+dequantizeElement(PPCEmuAssembler& a, QuantizedDataType type, double scale, bool scaled, const asmjit::X86Mem& dst)
+{
+   switch (type) {
+   case QuantizedDataType::Floating:
+      fastmemAccess<4, false>(a, true);
+      a.movd(a.xmm0, a.eax);
+      a.cvtss2sd(a.xmm0, a.xmm0);
+      a.movsd(dst, a.xmm0);
+      return;
+   case QuantizedDataType::Unsigned8:
+      a.mov(a.eax, 0);
+      fastmemAccess<1, false>(a, false);
+      break;
+   case QuantizedDataType::Signed8:
+      fastmemAccess<1, false>(a, false);
+      a.movsx(a.eax, a.eax.r8());
+      break;
+   case QuantizedDataType::Unsigned16:
+      a.mov(a.eax, 0);
+      fastmemAccess<2, false>(a, true);
+      break;
+   case QuantizedDataType::Signed16:
+      fastmemAccess<2, false>(a, true);
+      a.movsx(a.eax, a.eax.r16());
+      break;
+   default:
+      assert(0);
+   }
+
+   a.cvtsi2sd(a.xmm0, a.eax);
+
+   if (scaled) {
+      loadConstant(a, a.xmm1, scale);
+      a.mulsd(a.xmm0, a.xmm1);
+   }
+
+   a.movsd(dst, a.xmm0);
+}
+
+// The GQR is specialised on the value it had when the block was compiled,
+//   if it has changed since then the interpreter handles the load.
 template<unsigned flags = 0>
 static bool
 psqLoad(PPCEmuAssembler& a, Instruction instr)
 {
-   return jit_fallback(a, instr);
+   auto i = (flags & PsqLoadIndexed) ? instr.qi : instr.i;
+   auto w = (flags & PsqLoadIndexed) ? instr.qw : instr.w;
+
+   if (!a.gqrKnown) {
+      return jit_fallback(a, instr);
+   }
+
+   auto gqr = a.gqr[i];
+   auto type = static_cast<QuantizedDataType>(gqr.ld_type);
+   auto size = getQuantizedSize(type);
+   auto scaled = type != QuantizedDataType::Floating && gqr.ld_scale != 0;
+
+   if (!size) {
+      return jit_fallback(a, instr);
+   }
+
+   auto slowLbl = asmjit::Label(a);
+   auto doneLbl = asmjit::Label(a);
+   auto scale = getDequantizeScale(gqr.ld_scale);
+   a.cmp(a.ppcgqr[i], gqr.value);
+   a.jne(slowLbl);
+
+   calculatePsqAddress<flags & PsqLoadZeroRA, flags & PsqLoadIndexed>(a, instr);
+   dequantizeElement(a, type, scale, scaled, a.ppcfprps[instr.frD][0]);
+
+   if (w == 0) {
+      a.add(a.ecx, size);
+      dequantizeElement(a, type, scale, scaled, a.ppcfprps[instr.frD][1]);
+      a.sub(a.ecx, size);
+   } else {
+      a.mov(a.zax, bit_cast<uint64_t>(1.0));
+      a.mov(a.ppcfprps[instr.frD][1], a.zax);
+   }
+
+   if (flags & PsqLoadUpdate) {
+      a.storeGpr(instr.rA, a.ecx);
+   }
+
+   a.jmp(doneLbl);
+   a.bind(slowLbl);
+   jit_fallback(a, instr);
+   a.bind(doneLbl);
+   return true;
 }
 
 static bool
@@ -661,11 +912,118 @@ enum PsqStoreFlags
    PsqStoreIndexed = 1 << 2,
 };
 
+// Range of an integer quantized type
+static void
+getQuantizedRange(QuantizedDataType type, double& min, double& max)
+{
+   switch (type) {
+   case QuantizedDataType::Unsigned8:
+      min = std::numeric_limits<uint8_t>::min();
+      max = std::numeric_limits<uint8_t>::max();
+      break;
+   case QuantizedDataType::Signed8:
+      min = std::numeric_limits<int8_t>::min();
+      max = std::numeric_limits<int8_t>::max();
+      break;
+   case QuantizedDataType::Unsigned16:
+      min = std::numeric_limits<uint16_t>::min();
+      max = std::numeric_limits<uint16_t>::max();
+      break;
+   case QuantizedDataType::Signed16:
+      min = std::numeric_limits<int16_t>::min();
+      max = std::numeric_limits<int16_t>::max();
+      break;
+   default:
+      min = 0.0;
+      max = 0.0;
+      break;
+   }
+}
+
+// Store src as one quantized element at the guest address in ecx.  The
+//   constants are loaded again for each element as the access before may
+//   have called a slow path.
+static void
+quantizeElement(PPCEmuAssembler& a, QuantizedDataType type, double scale, bool scaled, const asmjit::X86Mem& src)
+{
+   if (type == QuantizedDataType::Floating) {
+      a.cvtsd2ss(a.xmm0, src);
+      a.movd(a.eax, a.xmm0);
+      fastmemAccess<4, true>(a, true);
+      return;
+   }
+
+   double min, max;
+   getQuantizedRange(type, min, max);
+
+   if (scaled) {
+      loadConstant(a, a.xmm1, scale);
+   }
+
+   loadConstant(a, a.xmm2, min);
+   loadConstant(a, a.xmm3, max);
+   a.movsd(a.xmm0, src);
+
+   if (scaled) {
+      a.mulsd(a.xmm0, a.xmm1);
+   }
+
+   // max first so NaN clamps to min
+   a.maxsd(a.xmm0, a.xmm2);
+   a.minsd(a.xmm0, a.xmm3);
+   a.cvttsd2si(a.eax, a.xmm0);
+
+   if (getQuantizedSize(type) == 1) {
+      fastmemAccess<1, true>(a, false);
+   } else {
+      fastmemAccess<2, true>(a, true);
+   }
+}
+
 template<unsigned flags = 0>
 static bool
 psqStore(PPCEmuAssembler& a, Instruction instr)
 {
-   return jit_fallback(a, instr);
+   auto i = (flags & PsqStoreIndexed) ? instr.qi : instr.i;
+   auto w = (flags & PsqStoreIndexed) ? instr.qw : instr.w;
+
+   if (!a.gqrKnown) {
+      return jit_fallback(a, instr);
+   }
+
+   auto gqr = a.gqr[i];
+   auto type = static_cast<QuantizedDataType>(gqr.st_type);
+   auto size = getQuantizedSize(type);
+   auto scaled = type != QuantizedDataType::Floating && gqr.st_scale != 0;
+
+   if (!size) {
+      return jit_fallback(a, instr);
+   }
+
+   auto slowLbl = asmjit::Label(a);
+   auto doneLbl = asmjit::Label(a);
+   auto scale = 1.0 / getDequantizeScale(gqr.st_scale);
+   a.cmp(a.ppcgqr[i], gqr.value);
+   a.jne(slowLbl);
+
+   calculatePsqAddress<flags & PsqStoreZeroRA, flags & PsqStoreIndexed>(a, instr);
+   quantizeElement(a, type, scale, scaled, a.ppcfprps[instr.frS][0]);
+
+   if (w == 0) {
+      a.add(a.ecx, size);
+      quantizeElement(a, type, scale, scaled, a.ppcfprps[instr.frS][1]);
+      a.sub(a.ecx, size);
+   }
+
+   if (flags & PsqStoreUpdate) {
+      a.storeGpr(instr.rA, a.ecx);
+   }
+
+   a.jmp(doneLbl);
+   a.bind(slowLbl);
+   jit_fallback(a, instr);
+   a.bind(doneLbl);
+   return true;
 }
 
 static bool
@@ -677,7 +1035,7 @@ psq_st(PPCEmuAssembler& a, Instruction instr)
 static bool
 psq_stu(PPCEmuAssembler& a, Instruction instr)
 {
-   return psqStore<PsqLoadUpdate>(a, instr);
+   return psqStore<PsqStoreUpdate>(a, instr);
 }
 
 static bool
@@ -2,6 +2,360 @@
 #include "jit.h"
 #include "jit_float.h"
 
+// Packed double code does not track FPSCR, see JitFloatMode
+static bool
+canGenFast(PPCEmuAssembler& a, Instruction instr)
+{
+   return a.fastFloat && !instr.rc;
+}
+
+// Load frN.paired{slot} into both halves of xmm
+static void
+loadBroadcast(PPCEmuAssembler& a, const asmjit::X86XmmReg& xmm, uint32_t fr, uint32_t slot)
+{
+   a.movsd(xmm, a.ppcfprps[fr][slot]);
+   a.unpcklpd(xmm, xmm);
+}
+
+// Arithmetic
+enum PsArithOperator
+{
+   PsAdd,
+   PsSub,
+   PsMul,
+   PsDiv,
+};
+
+template<PsArithOperator op>
+static bool
+psArithGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (!canGenFast(a, instr)) {
+      return jit_fallback(a, instr);
+   }
+
+   a.movupd(a.xmm0, a.ppcfpr[instr.frA]);
+
+   if (op == PsMul) {
+      a.movupd(a.xmm1, a.ppcfpr[instr.frC]);
+   } else {
+      a.movupd(a.xmm1, a.ppcfpr[instr.frB]);
+   }
+
+   switch (op) {
+   case PsAdd:
+      a.addpd(a.xmm0, a.xmm1);
+      break;
+   case PsSub:
+      a.subpd(a.xmm0, a.xmm1);
+      break;
+   case PsMul:
+      a.mulpd(a.xmm0, a.xmm1);
+      break;
+   case PsDiv:
+      a.divpd(a.xmm0, a.xmm1);
+      break;
+   }
+
+   a.movupd(a.ppcfpr[instr.frD], a.xmm0);
+   return true;
+}
+
+static bool
+ps_add(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PsAdd>(a, instr);
+}
+
+static bool
+ps_div(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PsDiv>(a, instr);
+}
+
+static bool
+ps_mul(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PsMul>(a, instr);
+}
+
+static bool
+ps_sub(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PsSub>(a, instr);
+}
+
+// Multiply Scalar
+template<unsigned slot>
+static bool
+mulScalarGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (!canGenFast(a, instr)) {
+      return jit_fallback(a, instr);
+   }
+
+   loadBroadcast(a, a.xmm1, instr.frC, slot);
+   a.movupd(a.xmm0, a.ppcfpr[instr.frA]);
+   a.mulpd(a.xmm0, a.xmm1);
+   a.movupd(a.ppcfpr[instr.frD], a.xmm0);
+   return true;
+}
+
+static bool
+ps_muls0(PPCEmuAssembler& a, Instruction instr)
+{
+   return mulScalarGeneric<0>(a, instr);
+}
+
+static bool
+ps_muls1(PPCEmuAssembler& a, Instruction instr)
+{
+   return mulScalarGeneric<1>(a, instr);
+}
+
+// Multiply and Add
+enum PsMaddFlags
+{
+   PsMaddScalar0 = 1 << 0, // c = c0, c0
+   PsMaddScalar1 = 1 << 1, // c = c1, c1
+   PsMaddSubtract = 1 << 2, // d = a * c - b
+   PsMaddNegate = 1 << 3, // d = -d
+};
+
+template<unsigned flags = 0>
+static bool
+maddGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (!canGenFast(a, instr)) {
+      return jit_fallback(a, instr);
+   }
+
+   if (flags & PsMaddNegate) {
+      a.mov(a.zax, UINT64_C(0x8000000000000000));
+      a.movq(a.xmm2, a.zax);
+      a.unpcklpd(a.xmm2, a.xmm2);
+   }
+
+   if (flags & PsMaddScalar0) {
+      loadBroadcast(a, a.xmm1, instr.frC, 0);
+   } else if (flags & PsMaddScalar1) {
+      loadBroadcast(a, a.xmm1, instr.frC, 1);
+   } else {
+      a.movupd(a.xmm1, a.ppcfpr[instr.frC]);
+   }
+
+   a.movupd(a.xmm0, a.ppcfpr[instr.frA]);
+   a.mulpd(a.xmm0, a.xmm1);
+   a.movupd(a.xmm1, a.ppcfpr[instr.frB]);
+
+   if (flags & PsMaddSubtract) {
+      a.subpd(a.xmm0, a.xmm1);
+   } else {
+      a.addpd(a.xmm0, a.xmm1);
+   }
+
+   if (flags & PsMaddNegate) {
+      a.xorpd(a.xmm0, a.xmm2);
+   }
+
+   a.movupd(a.ppcfpr[instr.frD], a.xmm0);
+   return true;
+}
+
+static bool
+ps_madd(PPCEmuAssembler& a, Instruction instr)
+{
+   return maddGeneric(a, instr);
+}
+
+static bool
+ps_madds0(PPCEmuAssembler& a, Instruction instr)
+{
+   return maddGeneric<PsMaddScalar0>(a, instr);
+}
+
+static bool
+ps_madds1(PPCEmuAssembler& a, Instruction instr)
+{
+   return maddGeneric<PsMaddScalar1>(a, instr);
+}
+
+static bool
+ps_msub(PPCEmuAssembler& a, Instruction instr)
+{
+   return maddGeneric<PsMaddSubtract>(a, instr);
+}
+
+static bool
+ps_nmadd(PPCEmuAssembler& a, Instruction instr)
+{
+   return maddGeneric<PsMaddNegate>(a, instr);
+}
+
+static bool
+ps_nmsub(PPCEmuAssembler& a, Instruction instr)
+{
+   return maddGeneric<PsMaddSubtract | PsMaddNegate>(a, instr);
+}
+
+// Reciprocal
+enum PsReciprocalFlags
+{
+   PsReciprocalSqrt = 1 << 0, // d = 1 / sqrt(b)
+};
+
+template<unsigned flags = 0>
+static bool
+reciprocalGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (!canGenFast(a, instr)) {
+      return jit_fallback(a, instr);
+   }
+
+   loadConstant(a, a.xmm0, 1.0);
+   a.unpcklpd(a.xmm0, a.xmm0);
+   a.movupd(a.xmm1, a.ppcfpr[instr.frB]);
+
+   if (flags & PsReciprocalSqrt) {
+      a.sqrtpd(a.xmm1, a.xmm1);
+   }
+
+   a.divpd(a.xmm0, a.xmm1);
+   a.movupd(a.ppcfpr[instr.frD], a.xmm0);
+   return true;
+}
+
+static bool
+ps_res(PPCEmuAssembler& a, Instruction instr)
+{
+   return reciprocalGeneric(a, instr);
+}
+
+static bool
+ps_rsqrte(PPCEmuAssembler& a, Instruction instr)
+{
+   return reciprocalGeneric<PsReciprocalSqrt>(a, instr);
+}
+
+// Select
+static bool
+ps_sel(PPCEmuAssembler& a, Instruction instr)
+{
+   if (!canGenFast(a, instr)) {
+      return jit_fallback(a, instr);
+   }
+
+   // mask = (0.0 <= a), false for NaN so it selects b
+   a.movupd(a.xmm0, a.ppcfpr[instr.frA]);
+   a.xorpd(a.xmm3, a.xmm3);
+   a.cmppd(a.xmm3, a.xmm0, 2);
+
+   a.movupd(a.xmm1, a.ppcfpr[instr.frC]);
+   a.movupd(a.xmm2, a.ppcfpr[instr.frB]);
+   a.andpd(a.xmm1, a.xmm3);
+   a.andnpd(a.xmm3, a.xmm2);
+   a.orpd(a.xmm1, a.xmm3);
+   a.movupd(a.ppcfpr[instr.frD], a.xmm1);
+   return true;
+}
+
+// Sum
+template<unsigned slot>
+static bool
+sumGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (!canGenFast(a, instr)) {
+      return jit_fallback(a, instr);
+   }
+
+   // d[slot] = a0 + b1, the other half comes from c
+   a.movsd(a.xmm0, a.ppcfprps[instr.frA][0]);
+   a.addsd(a.xmm0, a.ppcfprps[instr.frB][1]);
+   a.mov(a.zax, a.ppcfprps[instr.frC][1 - slot]);
+   a.movsd(a.ppcfprps[instr.frD][slot], a.xmm0);
+   a.mov(a.ppcfprps[instr.frD][1 - slot], a.zax);
+   return true;
+}
+
+static bool
+ps_sum0(PPCEmuAssembler& a, Instruction instr)
+{
+   return sumGeneric<0>(a, instr);
+}
+
+static bool
+ps_sum1(PPCEmuAssembler& a, Instruction instr)
+{
+   return sumGeneric<1>(a, instr);
+}
+
+// Sign bit operations
+enum PsSignOperator
+{
+   PsSignClear, // ps_abs
+   PsSignSet, // ps_nabs
+   PsSignFlip, // ps_neg
+   PsSignKeep, // ps_mr
+};
+
+template<PsSignOperator op>
+static bool
+signGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   // These never touch FPSCR so only the record forms need the fallback
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   a.mov(a.zax, a.ppcfprps[instr.frB][0]);
+   a.mov(a.zcx, a.ppcfprps[instr.frB][1]);
+
+   switch (op) {
+   case PsSignClear:
+      a.btr(a.zax, 63);
+      a.btr(a.zcx, 63);
+      break;
+   case PsSignSet:
+      a.bts(a.zax, 63);
+      a.bts(a.zcx, 63);
+      break;
+   case PsSignFlip:
+      a.btc(a.zax, 63);
+      a.btc(a.zcx, 63);
+      break;
+   case PsSignKeep:
+      break;
+   }
+
+   a.mov(a.ppcfprps[instr.frD][0], a.zax);
+   a.mov(a.ppcfprps[instr.frD][1], a.zcx);
+   return true;
+}
+
+static bool
+ps_abs(PPCEmuAssembler& a, Instruction instr)
+{
+   return signGeneric<PsSignClear>(a, instr);
+}
+
+static bool
+ps_nabs(PPCEmuAssembler& a, Instruction instr)
+{
+   return signGeneric<PsSignSet>(a, instr);
+}
+
+static bool
+ps_neg(PPCEmuAssembler& a, Instruction instr)
+{
+   return signGeneric<PsSignFlip>(a, instr);
+}
+
+static bool
+ps_mr(PPCEmuAssembler& a, Instruction instr)
+{
+   return signGeneric<PsSignKeep>(a, instr);
+}
+
 // Merge registers
 enum MergeFlags
 {
@@ -61,27 +415,27 @@ ps_merge10(PPCEmuAssembler& a, Instruction instr)
 void
 JitManager::registerPairedInstructions()
 {
-   RegisterInstructionFallback(ps_add);
-   RegisterInstructionFallback(ps_div);
-   RegisterInstructionFallback(ps_mul);
-   RegisterInstructionFallback(ps_sub);
-   RegisterInstructionFallback(ps_abs);
-   RegisterInstructionFallback(ps_nabs);
-   RegisterInstructionFallback(ps_neg);
-   RegisterInstructionFallback(ps_sel);
-   RegisterInstructionFallback(ps_res);
-   RegisterInstructionFallback(ps_rsqrte);
-   RegisterInstructionFallback(ps_msub);
-   RegisterInstructionFallback(ps_madd);
-   RegisterInstructionFallback(ps_nmsub);
-   RegisterInstructionFallback(ps_nmadd);
-   RegisterInstructionFallback(ps_mr);
-   RegisterInstructionFallback(ps_sum0);
-   RegisterInstructionFallback(ps_sum1);
-   RegisterInstructionFallback(ps_muls0);
-   RegisterInstructionFallback(ps_muls1);
-   RegisterInstructionFallback(ps_madds0);
-   RegisterInstructionFallback(ps_madds1);
+   RegisterInstruction(ps_add);
+   RegisterInstruction(ps_div);
+   RegisterInstruction(ps_mul);
+   RegisterInstruction(ps_sub);
+   RegisterInstruction(ps_abs);
+   RegisterInstruction(ps_nabs);
+   RegisterInstruction(ps_neg);
+   RegisterInstruction(ps_sel);
+   RegisterInstruction(ps_res);
+   RegisterInstruction(ps_rsqrte);
+   RegisterInstruction(ps_msub);
+   RegisterInstruction(ps_madd);
+   RegisterInstruction(ps_nmsub);
+   RegisterInstruction(ps_nmadd);
+   RegisterInstruction(ps_mr);
+   RegisterInstruction(ps_sum0);
+   RegisterInstruction(ps_sum1);
+   RegisterInstruction(ps_muls0);
+   RegisterInstruction(ps_muls1);
+   RegisterInstruction(ps_madds0);
+   RegisterInstruction(ps_madds1);
    RegisterInstruction(ps_merge00);
    RegisterInstruction(ps_merge01);
    RegisterInstruction(ps_merge10);
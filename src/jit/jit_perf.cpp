@@ -0,0 +1,147 @@
+#include <chrono>
+#include <cstring>
+#include "jit.h"
+#include "log.h"
+#include "platform.h"
+
+// jitdump format, see tools/perf/Documentation/jitdump-specification.txt
+//   in the Linux source.
+static const uint32_t JitDumpMagic = 0x4A695444;
+static const uint32_t JitDumpVersion = 1;
+static const uint32_t JitDumpMachX86_64 = 62;
+
+enum JitDumpRecord : uint32_t
+{
+   JitDumpCodeLoad = 0,
+   JitDumpCodeClose = 3,
+};
+
+#pragma pack(push, 1)
+struct JitDumpHeader
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t totalSize;
+   uint32_t elfMach;
+   uint32_t pad1;
+   uint32_t pid;
+   uint64_t timestamp;
+   uint64_t flags;
+};
+
+struct JitDumpRecordHeader
+{
+   uint32_t id;
+   uint32_t totalSize;
+   uint64_t timestamp;
+};
+
+struct JitDumpCodeLoadRecord
+{
+   JitDumpRecordHeader header;
+   uint32_t pid;
+   uint32_t tid;
+   uint64_t vma;
+   uint64_t codeAddr;
+   uint64_t codeSize;
+   uint64_t codeIndex;
+};
+#pragma pack(pop)
+
+// perf record -k mono uses CLOCK_MONOTONIC, which steady_clock is on Linux
+static uint64_t
+getTimestamp()
+{
+   auto now = std::chrono::steady_clock::now().time_since_epoch();
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+JitPerfMap::~JitPerfMap()
+{
+   close();
+}
+
+bool
+JitPerfMap::open(const std::string &dir)
+{
+   auto pid = platform::getProcessID();
+   auto mapPath = fmt::format("{}/perf-{}.map", dir, pid);
+   auto dumpPath = fmt::format("{}/jit-{}.dump", dir, pid);
+
+   mMap = std::fopen(mapPath.c_str(), "w");
+   mDump = std::fopen(dumpPath.c_str(), "wb+");
+
+   if (!mMap || !mDump) {
+      gLog->error("Could not create JIT perf map in {}", dir);
+      close();
+      return false;
+   }
+
+   JitDumpHeader header;
+   std::memset(&header, 0, sizeof(header));
+   header.magic = JitDumpMagic;
+   header.version = JitDumpVersion;
+   header.totalSize = sizeof(JitDumpHeader);
+   header.elfMach = JitDumpMachX86_64;
+   header.pid = pid;
+   header.timestamp = getTimestamp();
+   std::fwrite(&header, sizeof(header), 1, mDump);
+   std::fflush(mDump);
+
+   mMarker = platform::mapPerfMarker(mDump);
+   gLog->info("Writing JIT perf map to {}", mapPath);
+   return true;
+}
+
+void
+JitPerfMap::close()
+{
+   if (mDump) {
+      JitDumpRecordHeader record;
+      record.id = JitDumpCodeClose;
+      record.totalSize = sizeof(record);
+      record.timestamp = getTimestamp();
+      std::fwrite(&record, sizeof(record), 1, mDump);
+
+      platform::unmapPerfMarker(mMarker);
+      std::fclose(mDump);
+      mMarker = nullptr;
+      mDump = nullptr;
+   }
+
+   if (mMap) {
+      std::fclose(mMap);
+      mMap = nullptr;
+   }
+}
+
+// Called with the JitManager lock held
+void
+JitPerfMap::add(const std::string &name, const void *code, size_t size)
+{
+   if (!mMap) {
+      return;
+   }
+
+   auto addr = reinterpret_cast<uintptr_t>(code);
+   std::fprintf(mMap, "%llx %llx %s\n",
+                static_cast<unsigned long long>(addr),
+                static_cast<unsigned long long>(size),
+                name.c_str());
+   std::fflush(mMap);
+
+   JitDumpCodeLoadRecord record;
+   record.header.id = JitDumpCodeLoad;
+   record.header.totalSize = static_cast<uint32_t>(sizeof(record) + name.size() + 1 + size);
+   record.header.timestamp = getTimestamp();
+   record.pid = platform::getProcessID();
+   record.tid = record.pid;
+   record.vma = addr;
+   record.codeAddr = addr;
+   record.codeSize = size;
+   record.codeIndex = mCodeIndex++;
+   std::fwrite(&record, sizeof(record), 1, mDump);
+   std::fwrite(name.c_str(), name.size() + 1, 1, mDump);
+   std::fwrite(code, size, 1, mDump);
+   std::fflush(mDump);
+}
@@ -49,34 +49,34 @@ mfspr(PPCEmuAssembler& a, Instruction instr)
       a.mov(a.eax, a.ppcctr);
       break;
    case SprEncoding::GQR0:
-      a.mov(a.eax, a.ppcgpr[0]);
+      a.mov(a.eax, a.ppcgqr[0]);
       break;
    case SprEncoding::GQR1:
-      a.mov(a.eax, a.ppcgpr[1]);
+      a.mov(a.eax, a.ppcgqr[1]);
       break;
    case SprEncoding::GQR2:
-      a.mov(a.eax, a.ppcgpr[2]);
+      a.mov(a.eax, a.ppcgqr[2]);
       break;
    case SprEncoding::GQR3:
-      a.mov(a.eax, a.ppcgpr[3]);
+      a.mov(a.eax, a.ppcgqr[3]);
       break;
    case SprEncoding::GQR4:
-      a.mov(a.eax, a.ppcgpr[4]);
+      a.mov(a.eax, a.ppcgqr[4]);
       break;
    case SprEncoding::GQR5:
-      a.mov(a.eax, a.ppcgpr[5]);
+      a.mov(a.eax, a.ppcgqr[5]);
       break;
    case SprEncoding::GQR6:
-      a.mov(a.eax, a.ppcgpr[6]);
+      a.mov(a.eax, a.ppcgqr[6]);
       break;
    case SprEncoding::GQR7:
-      a.mov(a.eax, a.ppcgpr[7]);
+      a.mov(a.eax, a.ppcgqr[7]);
       break;
    default:
       gLog->error("Invalid mfspr SPR {}", static_cast<uint32_t>(spr));
    }
 
-   a.mov(a.ppcgpr[instr.rD], a.eax);
+   a.storeGpr(instr.rD, a.eax);
    return true;
 }
 
@@ -84,7 +84,7 @@ mfspr(PPCEmuAssembler& a, Instruction instr)
 static bool
 mtspr(PPCEmuAssembler& a, Instruction instr)
 {
-   a.mov(a.eax, a.ppcgpr[instr.rD]);
+   a.loadGpr(a.eax, instr.rD);
 
    auto spr = decodeSPR(instr);
    switch (spr) {
@@ -134,6 +134,128 @@ kcstub(ThreadState *state, KernelFunction *func)
    func->call(state);
 }
 
+// Call the host function directly, moving the guest arguments into the
+//   Windows x64 argument registers.  Returns false without generating
+//   anything if the signature needs the generic ppctypes::invoke path.
+static bool
+kcNative(PPCEmuAssembler& a, KernelFunction *func)
+{
+   using ppctypes::NativeType;
+   auto &sig = func->nativeSignature;
+
+   if (JIT_TRACE_KERNEL_CALLS || !func->nativeFunction || !sig.supported) {
+      return false;
+   }
+
+   // Arguments passed on the guest stack are left to invoke
+   auto r = 3u, f = 1u;
+
+   for (auto i = 0u; i < sig.numArgs; ++i) {
+      if (sig.args[i] == NativeType::Float || sig.args[i] == NativeType::Double) {
+         f++;
+      } else if (sig.args[i] == NativeType::Int64) {
+         r += 2;
+      } else {
+         r++;
+      }
+   }
+
+   if (r > 11 || f > 14) {
+      return false;
+   }
+
+   const asmjit::X86GpReg gpArgs[] = { a.zcx, a.zdx, asmjit::x86::r8, asmjit::x86::r9 };
+   const asmjit::X86XmmReg xmmArgs[] = { a.xmm0, a.xmm1, a.xmm2, a.xmm3 };
+   r = 3;
+   f = 1;
+
+   a.flushGprCache();
+
+   for (auto i = 0u; i < sig.numArgs; ++i) {
+      auto &gp = gpArgs[i];
+
+      switch (sig.args[i]) {
+      case NativeType::Float:
+         a.cvtsd2ss(xmmArgs[i], a.ppcfprps[f++][0]);
+         break;
+      case NativeType::Double:
+         a.movsd(xmmArgs[i], a.ppcfprps[f++][0]);
+         break;
+      case NativeType::Bool:
+         a.xor_(gp.r32(), gp.r32());
+         a.cmp(a.ppcgpr[r++], 0);
+         a.setne(gp.r8());
+         break;
+      case NativeType::Int64:
+         a.mov(gp.r32(), a.ppcgpr[r++]);
+         a.shl(gp, 32);
+         a.mov(a.eax, a.ppcgpr[r++]);
+         a.or_(gp, a.zax);
+         break;
+      case NativeType::Pointer:
+         // Guest null stays null
+         a.mov(a.eax, a.ppcgpr[r++]);
+         a.lea(gp, asmjit::x86::ptr(a.membase, a.zax));
+         a.test(a.eax, a.eax);
+         a.cmove(gp, a.zax);
+         break;
+      default:
+         a.mov(gp.r32(), a.ppcgpr[r++]);
+         break;
+      }
+   }
+
+   a.mov(a.zax, asmjit::Ptr(func->nativeFunction));
+   a.call(a.zax);
+
+   switch (sig.result) {
+   case NativeType::Void:
+      break;
+   case NativeType::Bool:
+   case NativeType::UInt8:
+      a.movzx(a.eax, a.zax.r8());
+      a.mov(a.ppcgpr[3], a.eax);
+      break;
+   case NativeType::Int8:
+      a.movsx(a.eax, a.zax.r8());
+      a.mov(a.ppcgpr[3], a.eax);
+      break;
+   case NativeType::UInt16:
+      a.movzx(a.eax, a.zax.r16());
+      a.mov(a.ppcgpr[3], a.eax);
+      break;
+   case NativeType::Int16:
+      a.movsx(a.eax, a.zax.r16());
+      a.mov(a.ppcgpr[3], a.eax);
+      break;
+   case NativeType::Int64:
+      a.mov(a.ppcgpr[4], a.eax);
+      a.shr(a.zax, 32);
+      a.mov(a.ppcgpr[3], a.eax);
+      break;
+   case NativeType::Pointer:
+      a.mov(a.zcx, a.zax);
+      a.sub(a.zcx, a.membase);
+      a.test(a.zax, a.zax);
+      a.cmove(a.zcx, a.zax);
+      a.mov(a.ppcgpr[3], a.ecx);
+      break;
+   case NativeType::Float:
+      a.cvtss2sd(a.xmm0, a.xmm0);
+      a.movsd(a.ppcfprps[1][0], a.xmm0);
+      break;
+   case NativeType::Double:
+      a.movsd(a.ppcfprps[1][0], a.xmm0);
+      break;
+   default:
+      a.mov(a.ppcgpr[3], a.eax);
+      break;
+   }
+
+   a.reloadGprCache();
+   return true;
+}
+
 // Kernel call
 static bool
 kc(PPCEmuAssembler& a, Instruction instr)
@@ -149,9 +271,18 @@ kc(PPCEmuAssembler& a, Instruction instr)
       return true;
    }
 
+   // Kernel functions may look at the caller, e.g. for logging
+   a.storeCia();
+
+   if (kcNative(a, sym)) {
+      return true;
+   }
+
+   a.flushGprCache();
    a.mov(a.zcx, a.state);
    a.mov(a.zdx, asmjit::Ptr(sym));
    a.call(asmjit::Ptr(kcstub));
+   a.reloadGprCache();
    return true;
 }
 
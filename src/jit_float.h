@@ -2,4 +2,13 @@
 #include "jit.h"
 
 void
-updateFloatConditionRegister(PPCEmuAssembler& a, const asmjit::X86GpReg& tmp, const asmjit::X86GpReg& tmp2);
\ No newline at end of file
+updateFloatConditionRegister(PPCEmuAssembler& a, const asmjit::X86GpReg& tmp, const asmjit::X86GpReg& tmp2);
+
+void
+loadConstant(PPCEmuAssembler& a, const asmjit::X86XmmReg& xmm, double value);
+
+void
+flushFloatStatus(PPCEmuAssembler& a);
+
+bool
+isNativeFloat(InstructionID id);
\ No newline at end of file
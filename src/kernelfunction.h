@@ -3,6 +3,7 @@
 #include "kernelexport.h"
 #include "ppc.h"
 #include "ppcinvoke.h"
+#include "ppcinvokenative.h"
 #include "util.h"
 
 // Kernel Function Export
@@ -20,6 +21,10 @@ struct KernelFunction : KernelExport
    uint32_t syscallID;
    uint32_t vaddr;
    virtual void call(ThreadState *state) = 0;
+
+   // Host function and its signature, lets the JIT call it directly
+   void *nativeFunction = nullptr;
+   ppctypes::NativeSignature nativeSignature;
 };
 
 namespace kernel
@@ -49,6 +54,8 @@ makeFunction(Ret(*fptr)(Args...))
 {
    auto func = new kernel::functions::KernelFunctionImpl<Ret, Args...>();
    func->wrapped_function = fptr;
+   func->nativeFunction = reinterpret_cast<void *>(fptr);
+   func->nativeSignature = ppctypes::makeNativeSignature<Ret, Args...>();
    return func;
 }
 
@@ -12,6 +12,7 @@
 #include "elf.h"
 #include "filesystem/filesystem.h"
 #include "instructiondata.h"
+#include "jit.h"
 #include "kernelmodule.h"
 #include "loader.h"
 #include "log.h"
@@ -171,6 +172,31 @@ getSymbolAddress(const elf::Symbol &sym, const SectionList &sections)
 }
 
 
+// Record a function entry point, size is 0 if unknown
+static void
+addFunction(LoadedModule *loadedMod, ppcaddr_t addr, ppcsize_t size)
+{
+   auto &fnSize = loadedMod->functions[addr];
+   fnSize = std::max(fnSize, size);
+}
+
+
+// Check if addr lies within a loaded code section
+static bool
+isCodeAddress(const SectionList &sections, ppcaddr_t addr)
+{
+   for (auto &section : sections) {
+      if (section.header.type == elf::SHT_PROGBITS && (section.header.flags & elf::SHF_EXECINSTR)) {
+         if (addr >= section.virtAddress && addr < section.virtAddress + section.virtSize) {
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+
 // Returns address of trampoline for target
 static ppcaddr_t
 getTrampAddress(LoadedModule *loadedMod, SequentialMemoryTracker &codeSeg, TrampolineMap &trampolines, void *target, const std::string& symbolName)
@@ -497,6 +523,16 @@ Loader::processRelocations(LoadedModule *loadedMod, const SectionList &sections,
             }
          }
 
+         // Branches and function pointers into our own code are function
+         //   entry points, other pointers may be jump table entries.
+         auto isFunctionPointer = type == elf::R_PPC_ADDR32 && (symbol.info & 0xf) == elf::STT_FUNC;
+
+         if (type == elf::R_PPC_REL24 || isFunctionPointer) {
+            if (symbolSection.header.type == elf::SHT_PROGBITS && (symbolSection.header.flags & elf::SHF_EXECINSTR)) {
+               addFunction(loadedMod, symAddr, 0);
+            }
+         }
+
          auto ptr8 = gMemory.translate(reloAddr);
          auto ptr16 = reinterpret_cast<uint16_t*>(ptr8);
          auto ptr32 = reinterpret_cast<uint32_t*>(ptr8);
@@ -682,6 +718,49 @@ Loader::processExports(LoadedModule *loadedMod, const SectionList &sections)
 
          loadedMod->exports.emplace(exportsName, exportsAddr);
          loadedMod->symbols.emplace(exportsName, exportsAddr);
+
+         if (isCodeAddress(sections, exportsAddr)) {
+            addFunction(loadedMod, exportsAddr, 0);
+         }
+      }
+   }
+
+   return true;
+}
+
+bool
+Loader::processFunctions(LoadedModule *loadedMod, const SectionList &sections)
+{
+   for (auto &section : sections) {
+      if (section.header.type != elf::SHT_SYMTAB) {
+         continue;
+      }
+
+      auto strTab = reinterpret_cast<const char*>(sections[section.header.link].memory);
+      auto symIn = BigEndianView { section.memory, section.virtSize };
+
+      while (!symIn.eof()) {
+         elf::Symbol sym;
+         elf::readSymbol(symIn, sym);
+
+         auto type = sym.info & 0xf;
+
+         if (type != elf::STT_FUNC || sym.shndx >= sections.size()) {
+            continue;
+         }
+
+         auto &symSec = sections[sym.shndx];
+
+         if (symSec.header.type != elf::SHT_PROGBITS || !(symSec.header.flags & elf::SHF_EXECINSTR)) {
+            continue;
+         }
+
+         auto addr = getSymbolAddress(sym, sections);
+         addFunction(loadedMod, addr, sym.size);
+
+         if (strTab && strTab[sym.name]) {
+            loadedMod->symbols.emplace(strTab + sym.name, addr);
+         }
       }
    }
 
@@ -818,6 +897,27 @@ Loader::loadRPL(const std::string& name, const gsl::array_view<uint8_t> &data)
       return nullptr;
    }
 
+   // Find function boundaries for the JIT
+   if (!processFunctions(loadedMod.get(), sections)) {
+      gLog->error("Error loading functions");
+      return nullptr;
+   }
+
+   if (isCodeAddress(sections, entryPoint)) {
+      addFunction(loadedMod.get(), entryPoint, 0);
+   }
+
+   for (auto &function : loadedMod->functions) {
+      gJitManager.addFunction(function.first, function.second);
+   }
+
+   // Name JIT blocks for host profilers
+   for (auto &symbol : loadedMod->symbols) {
+      if (isCodeAddress(sections, symbol.second)) {
+         gJitManager.addSymbol(symbol.second, name + "!" + symbol.first);
+      }
+   }
+
    // Create sections list
    for (auto &section : sections) {
       if (section.header.flags & elf::SHF_ALLOC) {
@@ -826,6 +926,10 @@ Loader::loadRPL(const std::string& name, const gsl::array_view<uint8_t> &data)
             auto start = section.virtAddress;
             auto end = section.virtAddress + section.virtSize;
             loadedMod->sections.emplace_back(LoadedSection { sectionName, start, end });
+
+            if (section.header.flags & elf::SHF_EXECINSTR) {
+               gJitManager.loadCache(name + sectionName, start, end);
+            }
          }
       }
    }
@@ -60,6 +60,7 @@ struct LoadedModule
    std::vector<LoadedSection> sections;
    std::map<std::string, ppcaddr_t> exports;
    std::map<std::string, ppcaddr_t> symbols;
+   std::map<ppcaddr_t, ppcsize_t> functions;
 };
 
 class SequentialMemoryTracker;
@@ -89,6 +90,7 @@ private:
 
    bool processImports(LoadedModule *loadedMod, const SectionList &sections);
    bool processExports(LoadedModule *loadedMod, const SectionList &sections);
+   bool processFunctions(LoadedModule *loadedMod, const SectionList &sections);
    bool processRelocations(LoadedModule *loadedMod, const SectionList &sections, BigEndianView &in, const char *shStrTab, SequentialMemoryTracker &codeSeg, AddressRange &trampSeg);
 
 private:
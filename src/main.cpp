@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <pugixml.hpp>
 #include <docopt.h>
 #include "bitutils.h"
@@ -41,16 +42,18 @@ gLog;
 
 void initialiseEmulator();
 bool test(const std::string &as, const std::string &path);
-bool fuzzTest();
+bool fuzzTest(bool checkDecode);
 bool play(const fs::HostPath &path);
+void printProfile(size_t count);
 
 static const char USAGE[] =
 R"(WiiU Emulator
 
 Usage:
-   wiiu play [--jit | --jitdebug] [--logfile] [--log-async] [--log-level=<log-level>] <game directory>
-   wiiu test [--jit | --jitdebug] [--logfile] [--log-async] [--log-level=<log-level>] [--as=<ppcas>] <test directory>
-   wiiu fuzz
+   wiiu play [--jit | --jitdebug | --jit-verify=<n>] [--jit-fast-math] [--jit-disable=<features>] [--jit-perf-map] [--logfile] [--log-async] [--log-level=<log-level>] <game directory>
+   wiiu profile [--jit-fast-math] [--jit-disable=<features>] [--jit-perf-map] [--profile-time] [--profile-top=<n>] [--logfile] [--log-async] [--log-level=<log-level>] <game directory>
+   wiiu test [--jit | --jitdebug | --jit-verify=<n>] [--jit-fast-math] [--jit-disable=<features>] [--jit-perf-map] [--logfile] [--log-async] [--log-level=<log-level>] [--as=<ppcas>] <test directory>
+   wiiu fuzz [--check-decode]
    wiiu (-h | --help)
    wiiu --version
 
@@ -58,6 +61,17 @@ Options:
    -h --help     Show this screen.
    --version     Show version.
    --jit         Enables the JIT engine.
+   --jit-verify=<n>  Enables the JIT engine and checks every n'th block entered
+                  against the interpreter, blocks are not linked together.
+   --jit-fast-math  Defer FPSCR updates of JIT float code until they can be observed.
+   --jit-disable=<features>
+                  Do not use these host cpu features in JIT code, comma separated.
+                  Available features: movbe, lzcnt, bmi1, bmi2, avx, all
+   --jit-perf-map  Write perf-<pid>.map and jit-<pid>.dump for host profilers.
+   --check-decode  Compare the flat decode tables against the opcode tree for
+                  every encoding instead of fuzzing.
+   --profile-time  Also count host cycles spent in each JIT block.
+   --profile-top=<n>  Number of blocks to report when profiling [default: 50].
    --logfile     Redirect log output to file.
    --log-async   Enable asynchronous logging.
    --log-level=<log-level> [default: trace]
@@ -77,14 +91,25 @@ int main(int argc, char **argv)
    auto args = docopt::docopt(USAGE, { argv + 1, argv + argc }, true, "WiiU 0.1");
    bool result = false;
 
-   if (args["--jitdebug"].asBool()) {
+   if (args["profile"].asBool()) {
+      gInterpreter.setJitMode(InterpJitMode::Enabled);
+      gJitManager.setProfileMode(args["--profile-time"].asBool() ? JitProfileMode::Time : JitProfileMode::Count);
+   } else if (args["--jitdebug"].asBool()) {
       gInterpreter.setJitMode(InterpJitMode::Debug);
+   } else if (args["--jit-verify"].isString()) {
+      gInterpreter.setJitMode(InterpJitMode::Verify);
+      gInterpreter.setVerifyPeriod(std::stoul(args["--jit-verify"].asString()));
+      gJitManager.setBlockLinking(false);
    } else if (args["--jit"].asBool()) {
       gInterpreter.setJitMode(InterpJitMode::Enabled);
    } else {
       gInterpreter.setJitMode(InterpJitMode::Disabled);
    }
 
+   if (args["--jit-fast-math"].asBool()) {
+      gJitManager.setFloatMode(JitFloatMode::Fast);
+   }
+
    // Create the logger
    std::vector<spdlog::sink_ptr> sinks;
    sinks.push_back(std::make_shared<spdlog::sinks::stdout_sink_st>());
@@ -92,7 +117,7 @@ int main(int argc, char **argv)
    if (args["--logfile"].asBool()) {
       std::string file;
 
-      if (args["play"].asBool()) {
+      if (args["play"].asBool() || args["profile"].asBool()) {
          file = getGameName(args["<game directory>"].asString());
       } else if (args["test"].asBool()) {
          file = "tests";
@@ -116,19 +141,38 @@ int main(int argc, char **argv)
       }
    }
 
+   if (args["--jit-disable"].isString()) {
+      if (!gJitManager.disableCpuFeatures(args["--jit-disable"].asString())) {
+         return -1;
+      }
+   }
+
+   if (args["--jit-perf-map"].asBool()) {
+#ifdef PLATFORM_POSIX
+      gJitManager.setPerfMapPath("/tmp");
+#else
+      gJitManager.setPerfMapPath(".");
+#endif
+   }
+
    initialiseEmulator();
 
    if (args["play"].asBool()) {
       gLog->set_pattern("[%l:%t] %v");
       result = play(args["<game directory>"].asString());
+   } else if (args["profile"].asBool()) {
+      gLog->set_pattern("[%l:%t] %v");
+      result = play(args["<game directory>"].asString());
+      printProfile(std::stoul(args["--profile-top"].asString()));
    } else if (args["fuzz"].asBool()) {
       gLog->set_pattern("%v");
-      result = fuzzTest();
+      result = fuzzTest(args["--check-decode"].asBool());
    } else if (args["test"].asBool()) {
       gLog->set_pattern("%v");
       result = test(args["--as"].asString(), args["<test directory>"].asString());
    }
 
+   gJitManager.shutdown();
    system("PAUSE");
    return result ? 0 : -1;
 }
@@ -197,11 +241,88 @@ test(const std::string &as, const std::string &path)
 }
 
 static bool
-fuzzTest()
+fuzzTest(bool checkDecode)
 {
+   if (checkDecode) {
+      return checkDecodeTables();
+   }
+
    return executeFuzzTests();
 }
 
+// Module and nearest preceding symbol for a guest code address
+static std::string
+describeAddress(ppcaddr_t addr)
+{
+   for (auto &itr : gLoader.getLoadedModules()) {
+      auto &module = itr.second;
+      auto inModule = std::any_of(module->sections.begin(), module->sections.end(),
+                                  [addr](const LoadedSection &section) {
+                                     return addr >= section.start && addr < section.end;
+                                  });
+
+      if (!inModule) {
+         continue;
+      }
+
+      const std::string *name = nullptr;
+      ppcaddr_t base = 0;
+
+      for (auto symbols : { &module->symbols, &module->exports }) {
+         for (auto &sym : *symbols) {
+            if (sym.second <= addr && sym.second >= base) {
+               name = &sym.first;
+               base = sym.second;
+            }
+         }
+      }
+
+      if (!name) {
+         return itr.first;
+      }
+
+      return fmt::format("{}!{}+0x{:X}", itr.first, *name, addr - base);
+   }
+
+   return "?";
+}
+
+static void
+printProfile(size_t count)
+{
+   auto profile = gJitManager.getProfile();
+   auto timed = gJitManager.getProfileMode() == JitProfileMode::Time;
+   uint64_t total = 0;
+
+   for (auto &entry : profile) {
+      total += timed ? entry.cycles : entry.count;
+   }
+
+   gLog->info("{} blocks profiled, top {} by {}:", profile.size(), count, timed ? "cycles" : "entries");
+   gLog->info("{:>8} {:>12} {:>14} {:>6}  {}", "address", "entries", "cycles", "host", "location");
+
+   for (auto i = 0u; i < profile.size() && i < count; ++i) {
+      auto &entry = profile[i];
+      auto share = total ? 100.0 * (timed ? entry.cycles : entry.count) / total : 0.0;
+
+      gLog->info("{:08X} {:>12} {:>14} {:>6}  {} ({:.2f}%)",
+                 entry.start, entry.count, entry.cycles, entry.hostSize, describeAddress(entry.start), share);
+   }
+
+   auto caches = gJitManager.getInlineCacheStats();
+   gLog->info("{} indirect branch sites, top {} by executions:", caches.size(), count);
+   gLog->info("{:>8} {:>12} {:>12} {:>7} {:>7}  {}", "address", "hits", "misses", "hit%", "targets", "location");
+
+   for (auto i = 0u; i < caches.size() && i < count; ++i) {
+      auto &cache = caches[i];
+      auto executions = cache.hits + cache.misses;
+      auto rate = executions ? 100.0 * cache.hits / executions : 0.0;
+
+      gLog->info("{:08X} {:>12} {:>12} {:>6.2f}% {:>7}  {}",
+                 cache.cia, cache.hits, cache.misses, rate, cache.targets, describeAddress(cache.cia));
+   }
+}
+
 static bool
 play(const fs::HostPath &path)
 {
@@ -210,6 +331,11 @@ play(const fs::HostPath &path)
    fs.mountHostFolder("/vol", path.join("data"));
    gSystem.setFileSystem(&fs);
 
+   // Keep the JIT block cache next to the game
+   if (gInterpreter.getJitMode() == InterpJitMode::Enabled) {
+      gJitManager.setCachePath(path.path());
+   }
+
    // Read cos.xml
    pugi::xml_document doc;
    auto fh = fs.openFile("/vol/code/cos.xml", fs::File::Read);
@@ -267,6 +393,8 @@ play(const fs::HostPath &path)
 
    platform::ui::run();
 
+   gJitManager.saveCache();
+
    // Force inclusion in release builds
    tracePrint(nullptr, 0, 0);
 
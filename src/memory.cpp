@@ -1,13 +1,59 @@
 #include "memory.h"
 #include "log.h"
+#include "util.h"
+#include <algorithm>
 #include <vector>
 #include <Windows.h>
 
 Memory gMemory;
 
+// Forward writes to read only guest pages to the write handler, and any
+//   other fault inside the guest address space to the access handler
+static LONG CALLBACK
+exceptionHandler(PEXCEPTION_POINTERS info)
+{
+   auto record = info->ExceptionRecord;
+
+   if (record->ExceptionCode != EXCEPTION_ACCESS_VIOLATION || record->ExceptionInformation[0] > 1) {
+      return EXCEPTION_CONTINUE_SEARCH;
+   }
+
+   auto write = record->ExceptionInformation[0] == 1;
+   auto host = static_cast<size_t>(record->ExceptionInformation[1]);
+   auto base = gMemory.base();
+
+   if (host < base || host >= base + 0x100000000ull + Memory::GuardSize) {
+      return EXCEPTION_CONTINUE_SEARCH;
+   }
+
+   auto address = static_cast<ppcaddr_t>(host - base);
+   auto writeHandler = gMemory.getWriteFaultHandler();
+   auto accessHandler = gMemory.getAccessFaultHandler();
+
+   if (write && writeHandler && writeHandler(address)) {
+      return EXCEPTION_CONTINUE_EXECUTION;
+   }
+
+   if (accessHandler) {
+      auto hostPc = static_cast<uintptr_t>(info->ContextRecord->Rip);
+
+      if (accessHandler(hostPc, address, write)) {
+         info->ContextRecord->Rip = hostPc;
+         return EXCEPTION_CONTINUE_EXECUTION;
+      }
+   }
+
+   return EXCEPTION_CONTINUE_SEARCH;
+}
+
 Memory::~Memory()
 {
+   if (mExceptionHandler) {
+      RemoveVectoredExceptionHandler(mExceptionHandler);
+   }
+
    if (mFile) {
+      releaseGuards();
       unmapViews();
       CloseHandle(mFile);
    }
@@ -42,6 +88,8 @@ Memory::initialise()
       return false;
    }
 
+   reserveGuards();
+
    // Setup page table
    for (auto &view : mViews) {
       auto size = view.end - view.start;
@@ -50,7 +98,8 @@ Memory::initialise()
       view.pageTable.resize(pages);
       memset(view.pageTable.data(), 0, pages * sizeof(PageEntry));
    }
-   
+
+   mExceptionHandler = AddVectoredExceptionHandler(1, &exceptionHandler);
    return true;
 }
 
@@ -211,6 +260,36 @@ Memory::free(uint32_t address)
    return true;
 }
 
+bool
+Memory::protect(ppcaddr_t address, size_t size)
+{
+   DWORD oldProtect;
+   auto start = alignDown(address, HostPageSize);
+   auto end = alignUp(address + size, HostPageSize);
+
+   if (!VirtualProtect(mBase + start, end - start, PAGE_READONLY, &oldProtect)) {
+      gLog->error("Failed to write protect memory at {:08x}", address);
+      return false;
+   }
+
+   return true;
+}
+
+bool
+Memory::unprotect(ppcaddr_t address, size_t size)
+{
+   DWORD oldProtect;
+   auto start = alignDown(address, HostPageSize);
+   auto end = alignUp(address + size, HostPageSize);
+
+   if (!VirtualProtect(mBase + start, end - start, PAGE_READWRITE, &oldProtect)) {
+      gLog->error("Failed to unprotect memory at {:08x}", address);
+      return false;
+   }
+
+   return true;
+}
+
 bool
 Memory::tryMapViews(uint8_t *base)
 {
@@ -232,6 +311,52 @@ Memory::tryMapViews(uint8_t *base)
    return true;
 }
 
+// Reserve everything in the guest address space which is not a view, plus
+//   a guard after it, so no host allocation can end up where a stray guest
+//   pointer would reach it.  Accesses there fault instead.
+void
+Memory::reserveGuards()
+{
+   auto reserve = [this](size_t start, size_t end) {
+      if (end <= start) {
+         return;
+      }
+
+      auto guard = VirtualAlloc(mBase + start, end - start, MEM_RESERVE, PAGE_NOACCESS);
+
+      if (!guard) {
+         gLog->warn("Could not reserve guard region {:x} to {:x}", start, end);
+         return;
+      }
+
+      mGuards.push_back(guard);
+   };
+
+   auto views = mViews;
+   std::sort(views.begin(), views.end(), [](const MemoryView &lhs, const MemoryView &rhs) {
+      return lhs.start < rhs.start;
+   });
+
+   auto last = size_t { 0 };
+
+   for (auto &view : views) {
+      reserve(last, view.start);
+      last = view.end;
+   }
+
+   reserve(last, 0x100000000ull + GuardSize);
+}
+
+void
+Memory::releaseGuards()
+{
+   for (auto guard : mGuards) {
+      VirtualFree(guard, 0, MEM_RELEASE);
+   }
+
+   mGuards.clear();
+}
+
 void
 Memory::unmapViews()
 {
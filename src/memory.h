@@ -45,9 +45,23 @@ struct MemoryView
    std::vector<PageEntry> pageTable;
 };
 
+// Called for a host write fault at a guest address, returns true when
+//   the fault was handled and the write can be retried.
+using WriteFaultHandler = bool(*)(ppcaddr_t address);
+
+// Called for any other host fault in the guest address space, may move
+//   hostPc to where execution should continue and return true.
+using AccessFaultHandler = bool(*)(uintptr_t &hostPc, ppcaddr_t address, bool write);
+
 class Memory
 {
 public:
+   static const uint32_t HostPageSize = 4 * 1024;
+
+   // Reserved after the 4 GiB guest space so accesses which start at the
+   //   end of it fault rather than touch host memory.
+   static const size_t GuardSize = 64 * 1024;
+
    ~Memory();
 
    bool initialise();
@@ -56,6 +70,30 @@ public:
    ppcaddr_t alloc(MemoryType type, size_t size);
    bool free(ppcaddr_t address);
 
+   // Make host pages covering the range read only or writable again
+   bool protect(ppcaddr_t address, size_t size);
+   bool unprotect(ppcaddr_t address, size_t size);
+
+   void setWriteFaultHandler(WriteFaultHandler handler)
+   {
+      mWriteFaultHandler = handler;
+   }
+
+   WriteFaultHandler getWriteFaultHandler() const
+   {
+      return mWriteFaultHandler;
+   }
+
+   void setAccessFaultHandler(AccessFaultHandler handler)
+   {
+      mAccessFaultHandler = handler;
+   }
+
+   AccessFaultHandler getAccessFaultHandler() const
+   {
+      return mAccessFaultHandler;
+   }
+
    size_t base() const
    {
       return (size_t)mBase;
@@ -125,10 +163,16 @@ private:
    MemoryView *getView(uint32_t address);
    bool tryMapViews(uint8_t *base);
    void unmapViews();
+   void reserveGuards();
+   void releaseGuards();
 
    uint8_t *mBase = nullptr;
    void *mFile = NULL;
+   void *mExceptionHandler = nullptr;
+   WriteFaultHandler mWriteFaultHandler = nullptr;
+   AccessFaultHandler mAccessFaultHandler = nullptr;
    std::vector<MemoryView> mViews;
+   std::vector<void *> mGuards;
 };
 
 extern Memory gMemory;
@@ -1,5 +1,7 @@
 #include "coreinit.h"
 #include "coreinit_cache.h"
+#include "jit.h"
+#include "memory_translate.h"
 #include "util.h"
 
 void
@@ -47,6 +49,14 @@ DCTouchRange(void *addr, uint32_t size)
    // TODO: DCTouchRange
 }
 
+void
+ICInvalidateRange(void *addr, uint32_t size)
+{
+   // Code writes are normally caught by the JIT write protection, this
+   //   covers anything which modified code without faulting.
+   gJitManager.invalidateRange(memory_untranslate(addr), size);
+}
+
 void
 CoreInit::registerCacheFunctions()
 {
@@ -57,4 +67,5 @@ CoreInit::registerCacheFunctions()
    RegisterKernelFunction(DCStoreRangeNoSync);
    RegisterKernelFunction(DCZeroRange);
    RegisterKernelFunction(DCTouchRange);
+   RegisterKernelFunction(ICInvalidateRange);
 }
\ No newline at end of file
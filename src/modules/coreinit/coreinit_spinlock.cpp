@@ -25,6 +25,8 @@ spinLock(OSSpinLock *spinlock)
    expected = 0;
 
    while (!spinlock->owner.compare_exchange_weak(expected, owner, std::memory_order_release, std::memory_order_relaxed)) {
+      // The owner may be a thread waiting to run on this core
+      gProcessor.idleLoop(memory_untranslate(spinlock));
       expected = 0;
    }
 }
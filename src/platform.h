@@ -1,12 +1,28 @@
 #pragma once
 
+#include <cstdint>
+#include <cstdio>
 #include <ctime>
+#include <string>
 #include <thread>
 
 namespace platform {
 
 tm localtime(const std::time_t& time);
 void set_thread_name(std::thread* thread, const std::string& threadName);
+uint32_t getProcessID();
+
+// Map the start of an open file executable so perf record notes its path,
+//   this is how perf inject finds jitdump files.
+void *mapPerfMarker(std::FILE *file);
+void unmapPerfMarker(void *marker);
+
+// Host cpuid, regs gets eax, ebx, ecx and edx
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]);
+
+// Extended control register index, AVX needs the OS to have enabled the
+//   ymm state in xcr0
+uint64_t xgetbv(uint32_t index);
 
 namespace ui {
 
@@ -1,8 +1,11 @@
 #include "../platform.h"
 #ifdef PLATFORM_POSIX
 
+#include <cpuid.h>
 #include <ctime>
 #include <thread>
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace platform {
 
@@ -19,6 +22,36 @@ void set_thread_name(std::thread* thread, thread, const std::string& threadName)
    pthread_setname_np(handle, threadName.c_str());
 }
 
+uint32_t getProcessID()
+{
+   return static_cast<uint32_t>(getpid());
+}
+
+void *mapPerfMarker(std::FILE *file)
+{
+   auto marker = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno(file), 0);
+   return marker == MAP_FAILED ? nullptr : marker;
+}
+
+void unmapPerfMarker(void *marker)
+{
+   if (marker) {
+      munmap(marker, sysconf(_SC_PAGESIZE));
+   }
+}
+
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+   __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+}
+
+uint64_t xgetbv(uint32_t index)
+{
+   uint32_t eax, edx;
+   __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+   return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+
 }
 
 #endif
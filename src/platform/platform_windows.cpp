@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <intrin.h>
 #include <windows.h>
 
 const DWORD MS_VC_EXCEPTION = 0x406D1388;
@@ -44,6 +45,36 @@ void set_thread_name(std::thread* thread, const std::string& threadName)
    }
 }
 
+uint32_t getProcessID()
+{
+   return GetCurrentProcessId();
+}
+
+// There is no perf on Windows, the map files are still useful to other tools
+void *mapPerfMarker(std::FILE *file)
+{
+   return nullptr;
+}
+
+void unmapPerfMarker(void *marker)
+{
+}
+
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+   int info[4];
+   __cpuidex(info, leaf, subleaf);
+
+   for (auto i = 0; i < 4; ++i) {
+      regs[i] = static_cast<uint32_t>(info[i]);
+   }
+}
+
+uint64_t xgetbv(uint32_t index)
+{
+   return _xgetbv(index);
+}
+
 namespace ui {
 
 TCHAR szAppName[] = TEXT("WiiUEmuClass");
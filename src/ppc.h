@@ -349,6 +349,16 @@ enum class SprEncoding
 
 // Thread registers
 // TODO: Some system registers may not be thread-specific!
+// Shadow return stack entry, see ThreadState::returnStack
+struct ReturnStackEntry
+{
+   uint32_t lr;         // Guest return address
+   uint32_t generation; // JitManager code generation when pushed
+   void *host;          // JIT code to resume at
+};
+
+static const uint32_t ReturnStackSize = 32;
+
 struct ThreadState
 {
    struct Tracer *tracer;
@@ -378,6 +388,24 @@ struct ThreadState
    bool reserve;
    uint32_t reserveAddress;
    uint32_t reserveData;
+
+   // JIT profiler, the block last entered and its rdtsc at entry
+   void *profileBlock = nullptr;
+   uint64_t profileStart = 0;
+
+   // JIT calls push their return address here so the matching blr can
+   //   jump straight back into the caller, a ring buffer indexed by
+   //   returnStackTop.
+   ReturnStackEntry returnStack[ReturnStackSize] = {};
+   uint32_t returnStackTop = 0;
+
+   // Bit of the core running this state in Processor::getPendingInterrupts,
+   //   set when a core switches to it.
+   uint32_t interruptMask = 0;
+
+   // JitManager retire epoch this state entered JIT code in, 0 while it
+   //   can not be running any, see JitCodeScope.
+   uint32_t jitEpoch = 0;
 };
 
 uint32_t
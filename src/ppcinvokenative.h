@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "ppctypes.h"
+
+namespace ppctypes
+{
+
+// How a kernel function argument or result is passed on the host, used
+//   by the JIT to call kernel functions without going through invoke.
+enum class NativeType : uint8_t
+{
+   Unsupported,
+   Void,
+   Bool,
+   Int8,
+   UInt8,
+   Int16,
+   UInt16,
+   Int32,
+   Int64,
+   Pointer,
+   Float,
+   Double,
+};
+
+static const size_t MaxNativeArgs = 4;
+
+struct NativeSignature
+{
+   bool supported;
+   NativeType result;
+   size_t numArgs;
+   NativeType args[MaxNativeArgs];
+};
+
+template<typename Type, bool IsEnum = std::is_enum<Type>::value>
+struct native_underlying_t
+{
+   typedef Type type;
+};
+
+template<typename Type>
+struct native_underlying_t<Type, true>
+{
+   typedef typename std::underlying_type<Type>::type type;
+};
+
+// Integers and enums, anything else has its own ppctype_converter_t
+template<typename Type>
+struct native_type_t
+{
+   typedef typename native_underlying_t<Type>::type Base;
+
+   static const NativeType value =
+      !std::is_integral<Base>::value ? NativeType::Unsupported :
+      sizeof(Base) == 1 ? (std::is_signed<Base>::value ? NativeType::Int8 : NativeType::UInt8) :
+      sizeof(Base) == 2 ? (std::is_signed<Base>::value ? NativeType::Int16 : NativeType::UInt16) :
+      sizeof(Base) == 4 ? NativeType::Int32 :
+      sizeof(Base) == 8 ? NativeType::Int64 :
+      NativeType::Unsupported;
+};
+
+template<typename Type>
+struct native_type_t<Type *>
+{
+   static const NativeType value = NativeType::Pointer;
+};
+
+// VarList& and other references
+template<typename Type>
+struct native_type_t<Type &>
+{
+   static const NativeType value = NativeType::Unsupported;
+};
+
+template<>
+struct native_type_t<void>
+{
+   static const NativeType value = NativeType::Void;
+};
+
+template<>
+struct native_type_t<bool>
+{
+   static const NativeType value = NativeType::Bool;
+};
+
+template<>
+struct native_type_t<float>
+{
+   static const NativeType value = NativeType::Float;
+};
+
+template<>
+struct native_type_t<double>
+{
+   static const NativeType value = NativeType::Double;
+};
+
+template<typename ReturnType, typename... Args>
+static inline NativeSignature
+makeNativeSignature()
+{
+   NativeType args[] = { native_type_t<Args>::value..., NativeType::Void };
+   NativeSignature sig;
+   sig.result = native_type_t<ReturnType>::value;
+   sig.numArgs = sizeof...(Args);
+   sig.supported = sig.numArgs <= MaxNativeArgs && sig.result != NativeType::Unsupported;
+
+   for (auto i = 0u; i < sig.numArgs && i < MaxNativeArgs; ++i) {
+      sig.args[i] = args[i];
+      sig.supported &= args[i] != NativeType::Unsupported;
+   }
+
+   return sig;
+}
+
+}
@@ -16,6 +16,12 @@ gProcessor { CoreCount };
 __declspec(thread) Core *
 tCurrentCore = nullptr;
 
+// Iterations of an idle loop before the core is given up
+static const uint32_t IdleLoopSpins = 64;
+
+// Longest an idle core sleeps without being woken
+static const auto IdleSleepTime = std::chrono::milliseconds(1);
+
 void
 Fiber::fiberEntryPoint(void *param)
 {
@@ -61,6 +67,9 @@ Processor::join()
    }
 
    mTimerThread.join();
+
+   auto idleTime = std::chrono::duration_cast<std::chrono::milliseconds>(getIdleTime());
+   gLog->info("Idle loops released {} ms of host cpu time", idleTime.count());
 }
 
 // Entry point of new fibers
@@ -101,13 +110,14 @@ Processor::coreEntryPoint(Core *core)
          // Switch to fiber
          core->currentFiber = fiber;
          fiber->coreID = core->id;
+         fiber->state.interruptMask = 1 << core->id;
          fiber->parentFiber = core->primaryFiber;
          fiber->thread->state = OSThreadState::Running;
          lock.unlock();
 
          gLog->trace("Core {} enter thread {}", core->id, fiber->thread->id);
          SwitchToFiber(fiber->handle);
-      } else if (core->interrupt) {
+      } else if (mPendingInterrupts & (1 << core->id)) {
          // Switch to the interrupt thread for any waiting interrupts
          lock.unlock();
          handleInterrupt();
@@ -185,6 +195,54 @@ Processor::yield()
    reschedule(false, true);
 }
 
+// Called every iteration of a loop found by isIdleLoop, the core is only
+//   given up once the loop has spun for a while.
+void
+Processor::idleLoop(uint32_t addr)
+{
+   auto core = tCurrentCore;
+
+   if (!core) {
+      return;
+   }
+
+   if (core->idleLoopAddr != addr) {
+      core->idleLoopAddr = addr;
+      core->idleLoopSpins = 0;
+   }
+
+   if (++core->idleLoopSpins >= IdleLoopSpins) {
+      core->idleLoopSpins = 0;
+      idle();
+   }
+}
+
+// Let other threads run, or sleep the host thread until an interrupt or a
+//   new thread for this core.  Other cores do not signal memory writes so
+//   the sleep is kept short.
+void
+Processor::idle()
+{
+   yield();
+
+   // We may have been rescheduled onto another core
+   auto core = tCurrentCore;
+
+   if (!core) {
+      return;
+   }
+
+   std::unique_lock<std::mutex> lock { mMutex };
+
+   if ((mPendingInterrupts & (1 << core->id)) || peekNextFiberNoLock(core->id)) {
+      return;
+   }
+
+   auto start = std::chrono::system_clock::now();
+   mCondition.wait_for(lock, IdleSleepTime);
+   mIdleTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now() - start).count();
+}
+
 // Exit current thread
 void
 Processor::exit()
@@ -320,7 +378,7 @@ Processor::timerEntryPoint()
 
       for (auto core : mCores) {
          if (core->nextInterrupt <= now) {
-            core->interrupt = true;
+            mPendingInterrupts |= 1 << core->id;
             core->nextInterrupt = std::chrono::time_point<std::chrono::system_clock>::max();
             wakeAllCores();
          } else if (core->nextInterrupt < next) {
@@ -353,15 +411,23 @@ Processor::handleInterrupt()
 {
    auto core = tCurrentCore;
 
-   if (core && core->interrupt) {
+   if (!core) {
+      return;
+   }
+
+   // The pending bit is the only interrupt flag, so testing and clearing it
+   //   in one step can not lose an interrupt set at the same time.
+   auto bit = 1u << core->id;
+
+   if (mPendingInterrupts.fetch_and(~bit) & bit) {
       if (core->currentFiber) {
          core->interruptedFiber = core->currentFiber;
       } else {
          core->interruptedFiber = nullptr;
       }
 
-      core->interrupt = false;
       core->currentFiber = core->interruptHandlerFiber;
+      core->currentFiber->state.interruptMask = bit;
       SwitchToFiber(core->currentFiber->handle);
    }
 }
@@ -390,7 +456,7 @@ Processor::setInterrupt(uint32_t core)
 {
    std::unique_lock<std::mutex> lock { mTimerMutex };
    mCores[core]->nextInterrupt = std::chrono::time_point<std::chrono::system_clock>::max();
-   mCores[core]->interrupt = true;
+   mPendingInterrupts |= 1 << core;
 }
 
 // Set the time of the next interrupt, will not overwrite sooner times
@@ -47,9 +47,12 @@ struct Core
    Fiber *interruptHandlerFiber = nullptr;
    void *primaryFiber = nullptr;
    std::thread thread;
-   std::atomic<bool> interrupt = false;
    std::chrono::system_clock::time_point nextInterrupt;
    std::vector<Fiber *> mFiberDeleteList;
+
+   // Idle loop the current thread is spinning in, see Processor::idleLoop
+   uint32_t idleLoopAddr = 0;
+   uint32_t idleLoopSpins = 0;
 };
 
 class Processor
@@ -73,6 +76,15 @@ public:
    void yield();
    void exit();
 
+   // Guest code which can only wait for another core or an interrupt
+   void idleLoop(uint32_t addr);
+   void idle();
+
+   // Total host time cores spent sleeping in idle
+   std::chrono::nanoseconds getIdleTime() const {
+      return std::chrono::nanoseconds { mIdleTime.load() };
+   }
+
    Fiber *getCurrentFiber();
 
    // Interrupts
@@ -85,6 +97,12 @@ public:
    void setInterrupt(uint32_t core);
    void setInterruptTimer(uint32_t core, std::chrono::time_point<std::chrono::system_clock> when);
 
+   // Bitmask of cores with a pending interrupt, linked JIT blocks check
+   //   their own core's bit before jumping straight into another block.
+   const std::atomic<uint32_t> *getPendingInterrupts() const {
+      return &mPendingInterrupts;
+   }
+
    // Core
    uint32_t getCoreID();
    uint32_t getCoreCount();
@@ -96,6 +114,15 @@ public:
       return mFiberList;
    }
 
+   // Calls fn for every fiber, none can be destroyed until it returns
+   template<typename Fn>
+   void forEachFiber(Fn fn) {
+      std::lock_guard<std::mutex> lock { mMutex };
+      for (auto fiber : mFiberList) {
+         fn(fiber);
+      }
+   }
+
 protected:
    friend Core;
    friend Fiber;
@@ -111,6 +138,8 @@ protected:
 
 private:
    std::atomic<bool> mRunning;
+   std::atomic<uint32_t> mPendingInterrupts { 0 };
+   std::atomic<uint64_t> mIdleTime { 0 };
    std::vector<Core*> mCores;
    std::mutex mMutex;
    std::condition_variable mCondition;
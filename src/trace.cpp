@@ -5,6 +5,7 @@
 #include "memory.h"
 #include "ppc.h"
 #include "trace.h"
+#include "interpreter.h"
 #include "system.h"
 #include "kernelfunction.h"
 #include "statedbg.h"
@@ -104,6 +105,7 @@ traceInit(ThreadState *state, size_t size)
    state->tracer->index = 0;
    state->tracer->numTraces = 0;
    state->tracer->traces.resize(size);
+   gInterpreter.reselectLoop();
 }
 
 static SprEncoding